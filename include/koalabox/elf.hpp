@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+/**
+ * Lightweight, read-only ELF reader. The file is memory-mapped rather than read,
+ * and only the structures that are explicitly requested are parsed,
+ * so that the cost of a query does not grow with the size of the binary.
+ */
+namespace koalabox::elf {
+    namespace fs = std::filesystem;
+
+    struct section_t {
+        std::string_view name;
+        uint64_t address; // Virtual address, i.e. relative to the module base for shared libraries
+        uint64_t size;
+        uint32_t type;
+    };
+
+    struct symbol_t {
+        std::string_view name;
+        uint64_t value;
+        uint64_t size;
+        uint8_t bind;
+        uint8_t type;
+        uint8_t visibility;
+        uint16_t section_index;
+    };
+
+    /**
+     * Memory-mapped ELF file. All string views returned by its methods
+     * point into the mapping and remain valid only as long as the file object is alive.
+     */
+    class file {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+
+        file(const uint8_t* data, size_t size);
+
+    public:
+        /** @return nullopt if the file cannot be mapped or is not a valid ELF file. */
+        static std::optional<file> open(const fs::path& path);
+
+        file(const file&) = delete;
+        file& operator=(const file&) = delete;
+        file(file&& other) noexcept;
+        file& operator=(file&& other) noexcept;
+        ~file();
+
+        /** @return ELFCLASS32 or ELFCLASS64 */
+        [[nodiscard]] uint8_t get_class() const;
+
+        [[nodiscard]] std::vector<section_t> get_sections() const;
+
+        /** @return Symbols of the .dynsym section, or an empty vector if there is none. */
+        [[nodiscard]] std::vector<symbol_t> get_dynamic_symbols() const;
+    };
+
+    /**
+     * Reads only the identification bytes of the file header, without mapping the whole file.
+     * @return ELFCLASS32 or ELFCLASS64, or nullopt if the file is not a valid ELF file.
+     */
+    std::optional<uint8_t> read_class(const fs::path& path);
+}
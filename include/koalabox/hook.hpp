@@ -1,9 +1,30 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <string>
+#include <vector>
 
-#define KB_HOOK_GET_HOOKED_FN(FUNC) koalabox::hook::get_hooked_function(#FUNC, FUNC)
-#define KB_HOOK_GET_SWAPPED_FN(CLASS, FUNC) koalabox::hook::get_swapped_function(CLASS, #FUNC, FUNC)
+/**
+ * Interns the function name only once per call site, so that subsequent lookups involve no string operations.
+ */
+#define KB_HOOK_ID(NAME) \
+    []() { \
+        static const auto hook_id = koalabox::hook::get_hook_id(NAME); \
+        return hook_id; \
+    }()
+
+// Resolves the trampoline with a single atomic load
+#define KB_HOOK_GET_HOOKED_FN(FUNC) koalabox::hook::get_hooked_function(KB_HOOK_ID(#FUNC), FUNC)
+#define KB_HOOK_GET_SWAPPED_FN(CLASS, FUNC) koalabox::hook::get_swapped_function(CLASS, KB_HOOK_ID(#FUNC), FUNC)
+
+/**
+ * Counts invocations of the enclosing hook callback and, for a sample of them, measures the time spent in it.
+ * Place at the top of the callback. Costs a single relaxed load while instrumentation is disabled.
+ */
+#define KB_HOOK_INSTRUMENT(FUNC) \
+    const koalabox::hook::instrumentation_scope kb_hook_instrumentation_scope(KB_HOOK_ID(#FUNC))
 
 #define KB_HOOK_DETOUR_ADDRESS(FUNC, ADDRESS) \
     koalabox::hook::detour_or_warn(ADDRESS, #FUNC, reinterpret_cast<void*>(FUNC))
@@ -16,12 +37,64 @@ namespace koalabox::hook {
         void** vtable;
     };
 
+    /**
+     * Interned function name of a detour hook. Stays the same for the lifetime of the process,
+     * even if the function is unhooked and hooked again.
+     */
+    using hook_id_t = uint32_t;
+
+    namespace details {
+        constexpr hook_id_t MAX_HOOK_IDS = 4096;
+
+        /** Trampolines of detoured functions indexed by hook id. Null if the function is not hooked. */
+        extern std::atomic<void*> trampolines[MAX_HOOK_IDS];
+
+        [[noreturn]] void panic_not_hooked(hook_id_t hook_id);
+
+#if defined(KB_LINUX)
+        /** Import hook part of forget_hooks_in_range. Matches hooks by the address of their GOT slots. */
+        size_t forget_import_hooks_in_range(const void* start_address, const void* end_address);
+
+        /** @return Whether the import of the function is hooked in any module. */
+        bool is_import_hooked(const std::string& function_name);
+#endif
+
+        struct hook_counters_t {
+            std::atomic<uint64_t> call_count;
+            std::atomic<uint64_t> sampled_call_count;
+            std::atomic<uint64_t> sampled_ticks;
+        };
+
+        extern hook_counters_t hook_counters[MAX_HOOK_IDS];
+        extern std::atomic<bool> is_instrumentation_enabled;
+        // Calls whose index has none of these bits set are timed
+        extern std::atomic<uint64_t> instrumentation_sample_mask;
+
+        // Called only for sampled calls, hence it is not worth exposing the intrinsics to every consumer
+        uint64_t read_timestamp();
+    }
+
+    /**
+     * Interns the function name. The function does not have to be hooked yet.
+     * @throws std::runtime_error if the id space is exhausted.
+     */
+    hook_id_t get_hook_id(const std::string& function_name);
+
     bool is_hooked(const std::string& function_name);
     bool is_vt_hooked(const void* class_ptr, const std::string& function_name);
     bool unhook(const std::string& function_name);
     bool unhook_vt(const void* class_ptr, const std::string& function_name);
     bool unhook_vt_all(const void* class_ptr);
 
+    /**
+     * Forgets every hook whose target lies within [start_address, end_address), e.g. in a module that has been
+     * unloaded. The hooks are not unhooked, since there is nothing left to restore, but the functions
+     * can be hooked again once the module is reloaded.
+     *
+     * @return Number of forgotten hooks.
+     */
+    size_t forget_hooks_in_range(const void* start_address, const void* end_address);
+
     void detour_or_throw(
         const void* address,
         const std::string& function_name,
@@ -58,6 +131,24 @@ namespace koalabox::hook {
         const void* callback_function
     );
 
+    struct detour_entry_t {
+        const void* address;
+        std::string function_name;
+        const void* callback_function;
+    };
+
+    /**
+     * Installs all detours or none of them. Entries are validated before anything is patched,
+     * and detours that were already installed are rolled back if any of the subsequent ones fails.
+     *
+     * @throws std::runtime_error if the batch is invalid or could not be installed.
+     */
+    void detour_batch_or_throw(const std::vector<detour_entry_t>& entries);
+
+    void detour_batch_or_warn(const std::vector<detour_entry_t>& entries);
+
+    void detour_batch(const std::vector<detour_entry_t>& entries);
+
     void swap_virtual_func_or_throw(
         const void* class_ptr,
         const std::string& function_name,
@@ -72,16 +163,78 @@ namespace koalabox::hook {
         const void* callback_function
     );
 
+    /**
+     * Patches the vtable of the given instance once, on behalf of every instance that shares it.
+     * Unlike swap_virtual_func, subsequent calls with other instances of the same class are no-ops,
+     * and their original functions are resolved through the vtable rather than the instance pointer.
+     */
+    void swap_shared_virtual_func_or_throw(
+        const void* class_ptr,
+        const std::string& function_name,
+        uint16_t ordinal,
+        const void* callback_function
+    );
+
+    void swap_shared_virtual_func(
+        const void* class_ptr,
+        const std::string& function_name,
+        uint16_t ordinal,
+        const void* callback_function
+    );
+
+#if defined(KB_LINUX)
+    /**
+     * Redirects calls that the module makes to an imported function by rewriting its GOT slots.
+     * Unlike a detour, no code is patched, so it also works on functions that are too short to detour,
+     * but calls made from other modules or via dlsym pointers are not intercepted.
+     * The original function is available via get_hooked_function, just like with detours,
+     * hence a function cannot be hooked via both at the same time.
+     *
+     * @throws std::runtime_error if the module does not import the function or its slots could not be patched.
+     */
+    void hook_import_or_throw(
+        void* module_handle,
+        const std::string& function_name,
+        const void* callback_function
+    );
+
+    void hook_import(
+        void* module_handle,
+        const std::string& function_name,
+        const void* callback_function
+    );
+
+    bool is_import_hooked(void* module_handle, const std::string& function_name);
+    bool unhook_import(void* module_handle, const std::string& function_name);
+#endif
+
     /**
      * @return address of the function that was hooked.
      */
     void* get_hooked_function_address(const std::string& function_name);
 
+    /**
+     * Lock-free and allocation-free alternative intended for hot hooked functions.
+     * @return address of the function that was hooked.
+     */
+    inline void* get_hooked_function_address(const hook_id_t hook_id) {
+        if(auto* const address = details::trampolines[hook_id].load(std::memory_order_acquire)) {
+            return address;
+        }
+
+        details::panic_not_hooked(hook_id);
+    }
+
     template<typename F>
     F get_hooked_function(const std::string& function_name, F) {
         return reinterpret_cast<F>(get_hooked_function_address(function_name));
     }
 
+    template<typename F>
+    F get_hooked_function(const hook_id_t hook_id, F) {
+        return reinterpret_cast<F>(get_hooked_function_address(hook_id));
+    }
+
     /**
      * @return address of the function that was hooked.
      */
@@ -90,11 +243,79 @@ namespace koalabox::hook {
         const std::string& function_name
     );
 
+    /**
+     * Lock-free in the common case, hence suitable for hot hooked functions.
+     * @return address of the function that was hooked.
+     */
+    void* get_swapped_function_address(const void* class_ptr, hook_id_t hook_id);
+
     template<typename F>
     F get_swapped_function(const void* class_ptr, const std::string& function_name, F) {
         return reinterpret_cast<F>(get_swapped_function_address(class_ptr, function_name));
     }
 
+    template<typename F>
+    F get_swapped_function(const void* class_ptr, const hook_id_t hook_id, F) {
+        return reinterpret_cast<F>(get_swapped_function_address(class_ptr, hook_id));
+    }
+
+    class instrumentation_scope {
+        hook_id_t hook_id;
+        uint64_t start_timestamp = 0;
+
+    public:
+        explicit instrumentation_scope(const hook_id_t hook_id) : hook_id(hook_id) {
+            if(not details::is_instrumentation_enabled.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            const auto call_index = details::hook_counters[hook_id].call_count.fetch_add(1, std::memory_order_relaxed);
+            if((call_index & details::instrumentation_sample_mask.load(std::memory_order_relaxed)) == 0) {
+                start_timestamp = details::read_timestamp();
+            }
+        }
+
+        ~instrumentation_scope() {
+            if(start_timestamp) {
+                auto& counters = details::hook_counters[hook_id];
+                counters.sampled_ticks.fetch_add(details::read_timestamp() - start_timestamp, std::memory_order_relaxed);
+                counters.sampled_call_count.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        instrumentation_scope(const instrumentation_scope&) = delete;
+        instrumentation_scope& operator=(const instrumentation_scope&) = delete;
+    };
+
+    /**
+     * @param sample_interval Every n-th call of each hook is timed. Rounded up to a power of 2.
+     * 1 times every call, which is accurate but considerably more expensive.
+     */
+    void enable_instrumentation(uint32_t sample_interval = 64);
+    void disable_instrumentation();
+    void reset_instrumentation();
+
+    struct hook_stats_t {
+        std::string function_name;
+        uint64_t call_count;
+        uint64_t sampled_call_count;
+        /** Extrapolated from the sampled calls. Includes the time spent in the original function. */
+        std::chrono::nanoseconds total_time;
+        std::chrono::nanoseconds average_time;
+    };
+
+    enum class stats_order { call_count, total_time };
+
+    /**
+     * @return Statistics of every hook that was invoked at least once, in descending order.
+     */
+    std::vector<hook_stats_t> get_instrumentation_snapshot(stats_order order = stats_order::call_count);
+
+    /**
+     * Logs the snapshot as a table, one line per hook.
+     */
+    void log_instrumentation_snapshot(stats_order order = stats_order::call_count);
+
     void init(bool print_info = false);
 
     bool is_hook_mode(void* self_module, const std::string& orig_library_name);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "koalabox/lib_monitor.hpp"
+#include "koalabox/patcher.hpp"
+#include "koalabox/str.hpp"
+
+#define KB_HOOK_PLAN_SYMBOL(FUNC) \
+    koalabox::hook_plan::symbol_hook_t{#FUNC, reinterpret_cast<void*>(FUNC)}
+
+/**
+ * Declarative description of the hooks to install in each module.
+ * Hooks are resolved and installed lazily, the moment their module is loaded.
+ */
+namespace koalabox::hook_plan {
+    struct symbol_hook_t {
+        std::string function_name;
+        const void* callback_function;
+    };
+
+    struct pattern_hook_t {
+        /** Identifies the hook, just like the function name of a symbol hook. */
+        std::string function_name;
+        patcher::pattern pattern;
+        const void* callback_function;
+    };
+
+    struct module_plan_t {
+        std::vector<symbol_hook_t> symbol_hooks;
+        std::vector<pattern_hook_t> pattern_hooks;
+    };
+
+    /** Key is DLL name without extension, just like in lib_monitor. */
+    using plan_t = std::map<lib_monitor::dll_name_t, module_plan_t, str::case_insensitive_compare>;
+
+    /**
+     * Resolves all symbols in a single pass over the export table of the module,
+     * and all patterns in a single pass over its executable regions.
+     * Resolved hooks are then installed as one batch. Hooks that could not be resolved are reported and skipped.
+     *
+     * @throws std::runtime_error if the batch could not be installed.
+     * @return Number of installed hooks.
+     */
+    size_t install(void* module_handle, const module_plan_t& module_plan);
+
+    /**
+     * @return Callbacks that install the plan of each module once it is loaded.
+     * They can be merged with other callbacks before being passed to lib_monitor::init_listener.
+     */
+    lib_monitor::callbacks_t to_callbacks(const plan_t& plan);
+}
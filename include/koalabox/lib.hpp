@@ -2,7 +2,13 @@
 
 #include <filesystem>
 #include <functional>
+#include <map>
+#include <memory>
 #include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #define KB_LIB_GET_FUNC(MODULE, PROC_NAME) \
@@ -32,6 +38,42 @@ namespace koalabox::lib {
     std::optional<void*> get_function_address(void* lib_handle, const char* function_name);
     void* get_function_address_or_throw(void* lib_handle, const char* function_name);
 
+    /**
+     * Functions defined by a loaded module, indexed by name. Built from the in-memory export table
+     * (.dynsym with its hash table on Linux, export directory on Windows), so that lookups
+     * neither go through the loader nor touch the file on disk.
+     * Names point into the module image, hence the index must not outlive the module.
+     */
+    struct symbol_index_t {
+        const void* base_address = nullptr;
+        std::unordered_map<std::string_view, void*> addresses;
+
+        /**
+         * @return nullopt if the module does not define the symbol, or if it cannot be resolved without the loader
+         * (e.g. forwarded exports and STT_GNU_IFUNC symbols).
+         */
+        [[nodiscard]] std::optional<void*> find(std::string_view name) const;
+    };
+
+    /**
+     * @return Symbol index of the module. It is built once per module handle and shared by subsequent calls.
+     */
+    std::shared_ptr<const symbol_index_t> get_symbol_index(void* lib_handle);
+
+    /**
+     * Same as get_function_address, but looks the function up in the symbol index of the module first,
+     * falling back to the loader only for functions that the index cannot resolve.
+     */
+    std::optional<void*> find_function_address(void* lib_handle, const std::string& function_name);
+
+    /**
+     * Resolves several functions through the symbol index of the module,
+     * instead of a separate loader lookup per function.
+     *
+     * @return Map of function names to their addresses. Functions that were not found are absent from the map.
+     */
+    std::map<std::string, void*> get_function_addresses(void* lib_handle, const std::set<std::string>& function_names);
+
     template<typename F>
     F get_function(void* lib_handle, const char* procedure_name, F) {
         return reinterpret_cast<F>(get_function_address_or_throw(lib_handle, procedure_name));
@@ -47,11 +89,27 @@ namespace koalabox::lib {
         void* lib_handle, const std::function<bool(const std::string& section_name)>& name_matches
     );
 
+    /// Returns every executable region of a loaded module, ordered by address: PT_LOAD segments with PF_X
+    /// on Linux and sections with IMAGE_SCN_MEM_EXECUTE on Windows. Only in-memory headers are read.
+    std::vector<section_t> get_executable_regions(void* lib_handle);
+
     std::optional<void*> load(const std::filesystem::path& library_path);
     void* load_or_throw(const std::filesystem::path& library_path);
     void unload(void* lib_handle);
     void* get_lib_handle(const std::string& lib_name);
 
+    /**
+     * Lists paths of all loaded modules with a single pass over the loader's module list.
+     * Unlike calling get_lib_handle per name, the cost does not grow with the number of names of interest.
+     */
+    std::vector<std::filesystem::path> get_loaded_module_paths();
+
+    /**
+     * @return Handle of the module loaded from the given path, or nullptr if there is none.
+     * The module is never loaded by this function.
+     */
+    void* get_loaded_lib_handle(const std::filesystem::path& lib_path);
+
     /**
      * Appends "_o" to library name and attempts to load it from the from_path
      */
@@ -64,4 +122,22 @@ namespace koalabox::lib {
     std::optional<bool> is_64bit(const std::filesystem::path& library_path);
 
     void* get_exe_handle();
+
+    /**
+     * Discards cached data (symbol indices, section tables) of modules based within [start_address, end_address).
+     * Must be called when a module is unloaded, since another one may later be loaded at the same address.
+     */
+    void invalidate_caches(const void* start_address, const void* end_address);
+
+    namespace details {
+        /**
+         * Platform-specific part of get_symbol_index, which takes care of caching.
+         * @return nullptr if the export table of the module cannot be read.
+         */
+        std::shared_ptr<symbol_index_t> read_symbol_index(void* lib_handle);
+
+#if defined(KB_LINUX)
+        void invalidate_section_cache(const void* start_address, const void* end_address);
+#endif
+    }
 }
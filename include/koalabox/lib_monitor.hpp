@@ -1,33 +1,131 @@
 #pragma once
 
+#include <chrono>
+#include <filesystem>
 #include <functional>
 #include <map>
+#include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "koalabox/str.hpp"
 
 /**
  * Cross-platform library monitor starts listening to library load events and
  * invokes corresponding callbacks when a target library is loaded.
+ * While listening, it also forgets hooks and cached data of libraries that get unloaded.
  */
 namespace koalabox::lib_monitor {
-    /** DLL name without extension. */
+    /**
+     * DLL name without extension. On Linux, the version suffix is excluded as well,
+     * e.g. <code>libfoo</code> for <code>libfoo.so.1.2</code>.
+     */
     using dll_name_t = std::string;
     /** @returns boolean indicating if the callback should be removed.*/
     using callback_t = std::function<bool(void* module_handle)>;
+    using unload_callback_t = std::function<void(const dll_name_t& lib_name)>;
     using callbacks_t = std::map<dll_name_t, callback_t, str::case_insensitive_compare>;
 
+    /** How a callback name is matched against names of loaded libraries. Matching is case-insensitive. */
+    enum class match_t : uint8_t {
+        exact,
+        /** The library name starts with the callback name. */
+        prefix,
+        /** The callback name is a pattern, in which <code>*</code> matches any sequence and <code>?</code> any character. */
+        glob,
+    };
+
+    /** Callback names without a rule are matched exactly. */
+    using match_rules_t = std::map<dll_name_t, match_t, str::case_insensitive_compare>;
+
+    enum class backend_t : uint8_t {
+        /**
+         * Linux: detours dlopen and dlmopen. Windows: loader DLL notifications, regardless of the backend.
+         */
+        loader_hook,
+        /**
+         * Linux only. Polls the link map from a background thread, without patching any code.
+         * The check between loads is a single read of the loader's load counter,
+         * but callbacks are delayed by up to one poll interval.
+         */
+        link_map_polling,
+    };
+
+    struct options_t {
+        backend_t backend = backend_t::loader_hook;
+        /** Used only by the link_map_polling backend. */
+        std::chrono::milliseconds poll_interval{10};
+        /**
+         * Whether callbacks should be invoked by a dedicated worker thread, in the order in which libraries
+         * were loaded, instead of by the thread that loaded the library. This way the loader, and everything
+         * waiting on its lock, is not stalled for the duration of the callbacks.
+         * Note that by the time a callback is invoked, the library may already be running its own code.
+         */
+        bool async_callbacks = false;
+        /**
+         * Callbacks that are invoked by the loading thread, even with async_callbacks. With the loader_hook backend,
+         * this means before the load returns. The link_map_polling backend notices loads only after they have
+         * returned, so there these callbacks are merely invoked by the polling thread instead of the worker.
+         */
+        std::set<dll_name_t, str::case_insensitive_compare> blocking_callbacks;
+        /** Applies both to libraries that are loaded later and to those that are already loaded. */
+        match_rules_t match_rules;
+        /**
+         * Invoked for every unloaded library, after its hooks and cached data have been forgotten.
+         * Libraries loaded with dlmopen into other namespaces are not tracked.
+         */
+        unload_callback_t unload_callback;
+    };
+
     bool is_initialized(); // platform-specific
 
     /** @throws runtime_error if there was an initialization error from kernel. */
-    void init_listener(const callbacks_t& callbacks);
+    void init_listener(const callbacks_t& callbacks, const options_t& options = {});
     void shutdown_listener();
 
     namespace details {
         callbacks_t& get_callbacks();
+
+        /**
+         * Callback names compiled into lookup tables, so that the cost of matching a library
+         * does not grow with the number of rules. Exact names are found with a single lookup,
+         * while prefixes, and literal beginnings of glob patterns, are looked up by each of their distinct lengths.
+         */
+        class lib_name_matcher {
+            struct rule_t {
+                dll_name_t callback_name;
+                match_t match;
+                std::string pattern; // Lowercase
+            };
+
+            std::unordered_map<std::string, dll_name_t> exact_names; // Key is lowercase name
+            std::unordered_map<std::string, std::vector<rule_t>> prefix_rules; // Key is lowercase literal prefix
+            std::set<size_t> prefix_lengths;
+
+        public:
+            lib_name_matcher() = default;
+            lib_name_matcher(const callbacks_t& callbacks, const match_rules_t& match_rules);
+
+            /** @return Names of all callbacks that match the library. */
+            [[nodiscard]] std::vector<dll_name_t> match(const dll_name_t& lib_name) const;
+        };
+
+        /** @return Name of the library, as matched against callback names. */
+        dll_name_t get_lib_name(const std::filesystem::path& lib_path);
         void on_library_loaded(const TCHAR* filename, void* lib_handle);
 
-        void init(); // platform-specific
+        /** @return Whether on_library_loaded would invoke any callback for the library. */
+        bool has_matching_callback(const TCHAR* filename);
+
+        /**
+         * Forgets hooks whose targets lie within the unloaded library, and discards its cached data.
+         * @param start_address Lowest address of the library image.
+         * @param end_address Address past the end of the library image.
+         */
+        void on_library_unloaded(const TCHAR* filename, const void* start_address, const void* end_address);
+
+        void init(const options_t& options); // platform-specific
         void shutdown(); // platform-specific
     }
 }
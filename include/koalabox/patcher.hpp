@@ -1,10 +1,305 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
 namespace koalabox::patcher {
+    namespace details {
+        constexpr int hex_digit_value(const char c) {
+            if(c >= '0' && c <= '9') {
+                return c - '0';
+            }
+            if(c >= 'a' && c <= 'f') {
+                return c - 'a' + 10;
+            }
+            if(c >= 'A' && c <= 'F') {
+                return c - 'A' + 10;
+            }
+            return -1;
+        }
+
+        /**
+         * Parses a user-friendly hex pattern (e.g. <code>"48 8B 05 ?? ?? ?? ?? 84 C0"</code>),
+         * invoking <code>on_byte(uint8_t byte, bool is_wildcard)</code> for each byte. Whitespace is ignored.
+         * Usable in constant evaluation, where a malformed pattern becomes a compilation error.
+         *
+         * @throws std::invalid_argument if the pattern is malformed
+         */
+        template<typename F>
+        constexpr void parse_pattern(const std::string_view hex, F&& on_byte) {
+            size_t byte_count = 0;
+
+            for(size_t i = 0; i < hex.size();) {
+                const auto c = hex[i];
+                if(c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                    ++i;
+                    continue;
+                }
+
+                if(i + 1 == hex.size()) {
+                    throw std::invalid_argument("Pattern ends with an incomplete byte");
+                }
+
+                const auto high = hex[i];
+                const auto low = hex[i + 1];
+                i += 2;
+
+                if(high == '?' && low == '?') {
+                    on_byte(static_cast<uint8_t>(0), true);
+                } else {
+                    const auto high_value = hex_digit_value(high);
+                    const auto low_value = hex_digit_value(low);
+                    if(high_value < 0 || low_value < 0) {
+                        throw std::invalid_argument("Pattern contains an invalid hex byte");
+                    }
+
+                    on_byte(static_cast<uint8_t>(high_value << 4 | low_value), false);
+                }
+
+                ++byte_count;
+            }
+
+            if(byte_count == 0) {
+                throw std::invalid_argument("Pattern is empty");
+            }
+        }
+    }
+
+    /**
+     * Pattern parsed at compile time from a string literal, so that malformed patterns fail the build:
+     * <code>constexpr static_pattern signature = "48 8B 05 ?? ?? ?? ?? 84 C0";</code>
+     */
+    template<size_t N>
+    struct static_pattern {
+        std::array<uint8_t, N> bytes{};
+        std::array<uint8_t, N> mask{};
+        size_t size = 0;
+
+        template<size_t L>
+        consteval static_pattern(const char (&hex)[L]) { // NOLINT(*-explicit-constructor)
+            details::parse_pattern(
+                {hex, L - 1},
+                [&](const uint8_t byte, const bool is_wildcard) {
+                    bytes[size] = byte;
+                    mask[size] = is_wildcard ? 0x00 : 0xFF;
+                    ++size;
+                }
+            );
+        }
+    };
+
+    // Every byte takes at least 2 characters, hence the capacity
+    template<size_t L>
+    static_pattern(const char (&)[L]) -> static_pattern<L / 2>;
+
+    /**
+     * Pattern prepared for scanning. Build it once and reuse it across scans
+     * to avoid parsing the pattern string on every call.
+     */
+    struct pattern {
+        std::vector<uint8_t> bytes;
+        /** 0xFF for bytes that must match, 0x00 for wildcards. */
+        std::vector<uint8_t> mask;
+
+        /** Offset of the rarest fixed byte, used by the scanner to filter candidates. */
+        size_t anchor = 0;
+        /** Offset of another fixed byte used as a secondary filter. Equals anchor if there is none. */
+        size_t second_anchor = 0;
+
+        pattern(std::vector<uint8_t> bytes, std::vector<uint8_t> mask);
+
+        template<size_t N>
+        pattern(const static_pattern<N>& source) // NOLINT(*-explicit-constructor)
+            : pattern(
+                std::vector(source.bytes.begin(), source.bytes.begin() + source.size),
+                std::vector(source.mask.begin(), source.mask.begin() + source.size)
+            ) {}
+
+        /**
+         * Parses a user-friendly hex pattern, e.g. <code>"48 8B 05 ?? ?? ?? ?? 84 C0"</code>.
+         * @throws std::invalid_argument if the pattern is malformed
+         */
+        static pattern from_str(std::string_view hex);
+
+        /**
+         * @return Canonical representation of the pattern, e.g. <code>"48 8B 05 ?? ?? ?? ?? 84 C0"</code>.
+         */
+        [[nodiscard]] std::string to_string() const;
+
+        [[nodiscard]] size_t size() const {
+            return bytes.size();
+        }
+    };
+
+    namespace details {
+        /** Implementations of the scan. The fastest one supported by the CPU is picked at runtime. */
+        enum class scan_engine {
+            scalar,
+            sse2,
+            avx2,
+        };
+
+        /** @return Whether the engine was compiled in and is supported by the CPU. */
+        bool is_engine_supported(scan_engine engine);
+
+        /**
+         * Same as the sequential scan, but with the given engine instead of the one picked at runtime,
+         * so that every engine can be tested on any machine that supports it.
+         * @return Address of the first match, or 0 if there is none.
+         */
+        uintptr_t find_with_engine(scan_engine engine, uintptr_t base_address, size_t scan_size, const pattern& pattern);
+    }
+
     uintptr_t find_pattern_address(
         uintptr_t base_address,
         size_t scan_size,
         const std::string& name,
         const std::string& pattern
     );
-}
\ No newline at end of file
+
+    uintptr_t find_pattern_address(
+        uintptr_t base_address,
+        size_t scan_size,
+        const std::string& name,
+        const pattern& pattern
+    );
+
+    /**
+     * Same as find_pattern_address, but splits the region into overlapping chunks
+     * that are scanned concurrently. Returns the lowest matching address, just like the sequential scan.
+     *
+     * @param thread_count Number of threads to scan with, including the calling one.
+     * 0 means one thread per hardware thread, which is also the upper limit,
+     * since helper threads are taken from a pool shared by all scans. See shutdown.
+     */
+    uintptr_t find_pattern_address_parallel(
+        uintptr_t base_address,
+        size_t scan_size,
+        const std::string& name,
+        const std::string& pattern,
+        unsigned thread_count = 0
+    );
+
+    uintptr_t find_pattern_address_parallel(
+        uintptr_t base_address,
+        size_t scan_size,
+        const std::string& name,
+        const pattern& pattern,
+        unsigned thread_count = 0
+    );
+
+    /**
+     * Stops and joins the helper threads of parallel scans. Call it before the library is unloaded,
+     * but not from DllMain, where joining threads deadlocks on the loader lock.
+     * A later parallel scan starts the threads anew.
+     */
+    void shutdown();
+
+    /**
+     * Scans every executable region of the module, as described by its in-memory headers,
+     * so that no section lookup on disk is necessary.
+     *
+     * @param parallel Whether each region should be scanned by several threads.
+     * @return Lowest matching address, or 0 if the pattern was not found.
+     */
+    uintptr_t find_in_module(
+        void* module_handle,
+        const std::string& name,
+        const std::string& pattern,
+        bool parallel = false
+    );
+
+    uintptr_t find_in_module(
+        void* module_handle,
+        const std::string& name,
+        const pattern& pattern,
+        bool parallel = false
+    );
+
+    /**
+     * Finds every match of the pattern in the region, in ascending order.
+     *
+     * @param max_count Maximum number of matches to collect. 0 means no limit.
+     */
+    std::vector<uintptr_t> find_all_pattern_addresses(
+        uintptr_t base_address,
+        size_t scan_size,
+        const std::string& name,
+        const std::string& pattern,
+        size_t max_count = 0
+    );
+
+    std::vector<uintptr_t> find_all_pattern_addresses(
+        uintptr_t base_address,
+        size_t scan_size,
+        const std::string& name,
+        const pattern& pattern,
+        size_t max_count = 0
+    );
+
+    /**
+     * Same as find_pattern_address, but also verifies that the pattern matches exactly once.
+     * @return Address of the only match, or 0 if the pattern was not found or is ambiguous.
+     */
+    uintptr_t find_unique_pattern_address(
+        uintptr_t base_address,
+        size_t scan_size,
+        const std::string& name,
+        const std::string& pattern
+    );
+
+    uintptr_t find_unique_pattern_address(
+        uintptr_t base_address,
+        size_t scan_size,
+        const std::string& name,
+        const pattern& pattern
+    );
+
+    /**
+     * Resolves several patterns in a single pass over the region,
+     * which is considerably cheaper than scanning it once per pattern.
+     *
+     * @param patterns Map of pattern names to user-friendly hex patterns.
+     * @return Map of pattern names to the address of their first match.
+     * Patterns that were not found are absent from the map.
+     */
+    std::map<std::string, uintptr_t> find_pattern_addresses(
+        uintptr_t base_address,
+        size_t scan_size,
+        const std::map<std::string, std::string>& patterns
+    );
+
+    std::map<std::string, uintptr_t> find_pattern_addresses(
+        uintptr_t base_address,
+        size_t scan_size,
+        const std::map<std::string, pattern>& patterns
+    );
+
+    /**
+     * Same as find_pattern_address, but remembers the address relative to the module base in the cache,
+     * keyed by the module's file size and modification time. Subsequent launches against the same build
+     * of the module skip the scan entirely, after a cheap re-comparison of the pattern at the cached address.
+     *
+     * @param module_handle Module that contains the scanned region.
+     */
+    uintptr_t find_pattern_address_cached(
+        void* module_handle,
+        uintptr_t base_address,
+        size_t scan_size,
+        const std::string& name,
+        const std::string& pattern
+    );
+
+    uintptr_t find_pattern_address_cached(
+        void* module_handle,
+        uintptr_t base_address,
+        size_t scan_size,
+        const std::string& name,
+        const pattern& pattern
+    );
+}
@@ -11,4 +11,8 @@ namespace koalabox::re {
     std::optional<uintptr_t> get_function_start(uintptr_t address);
 
     uintptr_t get_function_start_or_throw(uintptr_t address);
+
+    /// Discards cached unwind data of modules that overlap [start_address, end_address), e.g. after
+    /// the module has been unloaded.
+    void invalidate_cache(uintptr_t start_address, uintptr_t end_address);
 }
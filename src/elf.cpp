@@ -0,0 +1,257 @@
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "koalabox/elf.hpp"
+#include "koalabox/logger.hpp"
+#include "koalabox/path.hpp"
+
+namespace {
+    namespace elf = koalabox::elf;
+
+    template<typename Ehdr, typename Shdr, typename Sym>
+    struct layout_t {
+        using ehdr_t = Ehdr;
+        using shdr_t = Shdr;
+        using sym_t = Sym;
+    };
+
+    using elf32_t = layout_t<Elf32_Ehdr, Elf32_Shdr, Elf32_Sym>;
+    using elf64_t = layout_t<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym>;
+
+    /**
+     * Bounds-checked access to the mapped file. Every offset and count in an ELF file is untrusted,
+     * so all reads go through here and yield nullptr if they would reach past the end of the mapping.
+     */
+    struct view_t {
+        const uint8_t* data;
+        size_t size;
+
+        template<typename T>
+        const T* at(const uint64_t offset, const uint64_t count = 1) const {
+            if(offset > size || count > (size - offset) / sizeof(T)) {
+                return nullptr;
+            }
+
+            return reinterpret_cast<const T*>(data + offset);
+        }
+
+        std::string_view string_at(const uint64_t table_offset, const uint64_t table_size, const uint32_t index) const {
+            if(index >= table_size || table_offset > size || table_size > size - table_offset) {
+                return {};
+            }
+
+            const auto* const str = reinterpret_cast<const char*>(data + table_offset + index);
+            return {str, strnlen(str, table_size - index)};
+        }
+    };
+
+    template<typename Layout>
+    struct section_headers_t {
+        const typename Layout::shdr_t* headers = nullptr;
+        size_t count = 0;
+        size_t string_table_index = 0;
+    };
+
+    template<typename Layout>
+    section_headers_t<Layout> get_section_headers(const view_t& view) {
+        using shdr_t = typename Layout::shdr_t;
+
+        const auto* const header = view.at<typename Layout::ehdr_t>(0);
+        if(!header || header->e_shoff == 0 || header->e_shentsize != sizeof(shdr_t)) {
+            return {};
+        }
+
+        // Files with many sections store the real count and string table index in the first section header
+        const auto* const first = view.at<shdr_t>(header->e_shoff);
+        if(!first) {
+            return {};
+        }
+
+        const size_t count = header->e_shnum ? header->e_shnum : first->sh_size;
+        const size_t string_table_index = header->e_shstrndx == SHN_XINDEX ? first->sh_link : header->e_shstrndx;
+
+        const auto* const headers = view.at<shdr_t>(header->e_shoff, count);
+        if(!headers) {
+            return {};
+        }
+
+        return {headers, count, string_table_index};
+    }
+
+    template<typename Layout>
+    std::vector<elf::section_t> get_sections(const view_t& view) {
+        std::vector<elf::section_t> sections;
+
+        const auto [headers, count, string_table_index] = get_section_headers<Layout>(view);
+        if(!headers) {
+            return sections;
+        }
+
+        const auto* const string_table = string_table_index < count ? &headers[string_table_index] : nullptr;
+
+        sections.reserve(count);
+        for(size_t i = 0; i < count; ++i) {
+            const auto& header = headers[i];
+            sections.push_back(
+                {
+                    .name = string_table
+                                ? view.string_at(string_table->sh_offset, string_table->sh_size, header.sh_name)
+                                : std::string_view(),
+                    .address = header.sh_addr,
+                    .size = header.sh_size,
+                    .type = header.sh_type,
+                }
+            );
+        }
+
+        return sections;
+    }
+
+    template<typename Layout>
+    std::vector<elf::symbol_t> get_dynamic_symbols(const view_t& view) {
+        using sym_t = typename Layout::sym_t;
+
+        std::vector<elf::symbol_t> symbols;
+
+        const auto [headers, count, string_table_index] = get_section_headers<Layout>(view);
+        if(!headers) {
+            return symbols;
+        }
+
+        for(size_t i = 0; i < count; ++i) {
+            const auto& dynsym = headers[i];
+            if(dynsym.sh_type != SHT_DYNSYM || dynsym.sh_entsize != sizeof(sym_t) || dynsym.sh_link >= count) {
+                continue;
+            }
+
+            const auto& string_table = headers[dynsym.sh_link];
+            const auto symbol_count = dynsym.sh_size / sizeof(sym_t);
+            const auto* const entries = view.at<sym_t>(dynsym.sh_offset, symbol_count);
+            if(!entries) {
+                return symbols;
+            }
+
+            symbols.reserve(symbol_count);
+            for(size_t j = 0; j < symbol_count; ++j) {
+                const auto& entry = entries[j];
+                symbols.push_back(
+                    {
+                        .name = view.string_at(string_table.sh_offset, string_table.sh_size, entry.st_name),
+                        .value = entry.st_value,
+                        .size = entry.st_size,
+                        .bind = static_cast<uint8_t>(entry.st_info >> 4),
+                        .type = static_cast<uint8_t>(entry.st_info & 0xF),
+                        .visibility = static_cast<uint8_t>(entry.st_other & 0x3),
+                        .section_index = entry.st_shndx,
+                    }
+                );
+            }
+
+            break; // There can be only one .dynsym section
+        }
+
+        return symbols;
+    }
+
+    bool is_valid_ident(const uint8_t* ident) {
+        return std::memcmp(ident, ELFMAG, SELFMAG) == 0 &&
+               (ident[EI_CLASS] == ELFCLASS32 || ident[EI_CLASS] == ELFCLASS64) &&
+               ident[EI_DATA] == ELFDATA2LSB; // We only ever deal with x86 binaries
+    }
+}
+
+namespace koalabox::elf {
+    file::file(const uint8_t* data, const size_t size) : data(data), size(size) {}
+
+    file::file(file&& other) noexcept : data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0)) {}
+
+    file& file::operator=(file&& other) noexcept {
+        if(this != &other) {
+            this->~file();
+            data = std::exchange(other.data, nullptr);
+            size = std::exchange(other.size, 0);
+        }
+        return *this;
+    }
+
+    file::~file() {
+        if(data) {
+            munmap(const_cast<uint8_t*>(data), size);
+        }
+    }
+
+    std::optional<file> file::open(const fs::path& path) {
+        const auto path_str = path::to_str(path);
+
+        const auto fd = ::open(path_str.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0) {
+            LOG_ERROR("Failed to open ELF file: {}", path_str);
+            return std::nullopt;
+        }
+
+        struct stat file_stat{};
+        if(fstat(fd, &file_stat) != 0 || file_stat.st_size < static_cast<off_t>(sizeof(Elf32_Ehdr))) {
+            LOG_ERROR("Invalid ELF file size: {}", path_str);
+            close(fd);
+            return std::nullopt;
+        }
+
+        const auto size = static_cast<size_t>(file_stat.st_size);
+        auto* const mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // The mapping keeps its own reference to the file
+
+        if(mapping == MAP_FAILED) {
+            LOG_ERROR("Failed to map ELF file: {}", path_str);
+            return std::nullopt;
+        }
+
+        file result(static_cast<const uint8_t*>(mapping), size);
+
+        const auto header_size = result.get_class() == ELFCLASS64 ? sizeof(Elf64_Ehdr) : sizeof(Elf32_Ehdr);
+        if(!is_valid_ident(result.data) || size < header_size) {
+            LOG_ERROR("Not a valid ELF file: {}", path_str);
+            return std::nullopt;
+        }
+
+        return result;
+    }
+
+    uint8_t file::get_class() const {
+        return data[EI_CLASS];
+    }
+
+    std::vector<section_t> file::get_sections() const {
+        const view_t view{data, size};
+
+        return get_class() == ELFCLASS64 ? ::get_sections<elf64_t>(view) : ::get_sections<elf32_t>(view);
+    }
+
+    std::vector<symbol_t> file::get_dynamic_symbols() const {
+        const view_t view{data, size};
+
+        return get_class() == ELFCLASS64 ? ::get_dynamic_symbols<elf64_t>(view) : ::get_dynamic_symbols<elf32_t>(view);
+    }
+
+    std::optional<uint8_t> read_class(const fs::path& path) {
+        std::ifstream stream(path, std::ios::binary);
+        if(!stream.is_open()) {
+            LOG_ERROR("Failed to read ELF file: {}", path::to_str(path));
+            return std::nullopt;
+        }
+
+        uint8_t ident[EI_NIDENT]{};
+        if(!stream.read(reinterpret_cast<char*>(ident), sizeof(ident)) || !is_valid_ident(ident)) {
+            LOG_ERROR("Not a valid ELF file: {}", path::to_str(path));
+            return std::nullopt;
+        }
+
+        return ident[EI_CLASS];
+    }
+}
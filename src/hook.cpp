@@ -1,4 +1,24 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
 #include <ranges>
+#include <set>
+#include <shared_mutex>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #include <polyhook2/Detour/NatDetour.hpp>
 #include <polyhook2/Virtuals/VFuncSwapHook.hpp>
@@ -40,65 +60,512 @@ namespace {
         }
     };
 
+    /**
+     * Pool of fixed-size slots allocated in blocks. Addresses of objects remain stable for their lifetime,
+     * and freed slots are reused, hence creating an object does not allocate once the pool has warmed up.
+     */
+    template<typename T, size_t BLOCK_SIZE = 64>
+    class object_pool {
+        union slot_t {
+            slot_t* next_free;
+            alignas(T) std::byte storage[sizeof(T)];
+        };
+
+        std::mutex mutex;
+        std::vector<std::unique_ptr<slot_t[]>> blocks;
+        slot_t* free_list = nullptr;
+
+    public:
+        template<typename... Args>
+        T* create(Args&&... args) {
+            slot_t* slot;
+            {
+                const std::lock_guard lock(mutex);
+
+                if(not free_list) {
+                    auto& block = blocks.emplace_back(std::make_unique<slot_t[]>(BLOCK_SIZE));
+                    for(size_t i = 0; i < BLOCK_SIZE; ++i) {
+                        block[i].next_free = free_list;
+                        free_list = &block[i];
+                    }
+                }
+
+                slot = std::exchange(free_list, free_list->next_free);
+            }
+
+            return std::construct_at(reinterpret_cast<T*>(slot->storage), std::forward<Args>(args)...);
+        }
+
+        void destroy(T* object) {
+            std::destroy_at(object);
+
+            auto* const slot = reinterpret_cast<slot_t*>(object);
+
+            const std::lock_guard lock(mutex);
+            slot->next_free = free_list;
+            free_list = slot;
+        }
+    };
+
+    /**
+     * Everything a single hook owns, kept together in one pooled object.
+     * Hooks refer to its members by address, which is why they have to be stable.
+     */
+    struct hook_object_t {
+        std::optional<PLH::NatDetour> detour;
+        std::optional<PLH::VFuncSwapHook> swap_hook;
+        uint64_t trampoline = 0;
+        const void* target = nullptr; // Hooked function, by which hooks of unloaded modules are found
+        PLH::VFuncMap original_functions; // We need to save this to support unhooking
+        // Stand-in instance through which shared vtables are patched, since the original instance may be destroyed
+        kb::hook::virtual_class_t shared_class{};
+
+        PLH::IHook& get_hook() {
+            return detour ? static_cast<PLH::IHook&>(*detour) : *swap_hook;
+        }
+    };
+
+    object_pool<hook_object_t>& get_hook_object_pool() {
+        // Never destroyed, since hooked functions may still be running during static destruction
+        static auto* const pool = new object_pool<hook_object_t>();
+        return *pool;
+    }
+
+    struct hook_object_deleter {
+        void operator()(hook_object_t* object) const {
+            get_hook_object_pool().destroy(object);
+        }
+    };
+
+    // Destroying the object unhooks it if it is still installed, hence hooks that must stay in place are released
+    using hook_object_ptr = std::unique_ptr<hook_object_t, hook_object_deleter>;
+
     struct hook_data_t {
-        void* orig_func_ptr;
-        // NOTE: It's important to keep that as raw pointers,
-        // since wrapping them in unique_ptr makes the struct uncopiable,
-        // which leads to a multitude of problems on clang.
-        PLH::VFuncMap* vfunc_map; // We need to save this to support unhooking
-        PLH::IHook* hook;
+        void* orig_func_ptr = nullptr;
+        hook_object_ptr object;
     };
 
     // Key is function name.
     using function_to_hook_data_map = std::map<std::string, hook_data_t>;
 
-    // Used for vtable swap hooks. Key is class pointer.
-    auto& get_class_map() {
-        static std::map<const void*, function_to_hook_data_map> class_map;
-        return class_map;
+    /**
+     * Open-addressing hash table of virtual function swap hooks keyed by (class pointer, hook id), with linear probing.
+     * Hook data is stored inline in the slots, so a lookup is a single probe over contiguous memory
+     * rather than two tree walks with string comparisons.
+     *
+     * The table itself is guarded by the registry lock. Original functions are additionally mirrored
+     * into slots of atomics under a sequence lock, so that hooked functions can resolve them without taking the lock.
+     */
+    class vt_hook_table {
+        struct slot_t {
+            const void* class_ptr = nullptr; // Null marks an empty slot
+            kb::hook::hook_id_t hook_id = 0;
+            hook_data_t data{};
+        };
+
+        struct mirror_slot_t {
+            std::atomic<const void*> class_ptr = nullptr;
+            std::atomic<kb::hook::hook_id_t> hook_id = 0;
+            std::atomic<void*> orig_func_ptr = nullptr;
+        };
+
+        struct mirror_t {
+            std::unique_ptr<mirror_slot_t[]> slots;
+            size_t size;
+        };
+
+        std::vector<slot_t> slots = std::vector<slot_t>(64);
+        size_t count = 0;
+
+        // A new mirror is added whenever the table grows. Replaced ones are kept, since readers may still be probing them,
+        // but they take up less memory than the current one in total, since the table grows by doubling.
+        std::vector<std::unique_ptr<mirror_t>> mirrors;
+        std::atomic<mirror_t*> mirror = add_mirror(slots.size());
+        // Odd while the mirror is being written
+        std::atomic<uint64_t> sequence = 0;
+
+        static size_t get_home_index(const size_t size, const void* class_ptr, const kb::hook::hook_id_t hook_id) {
+            // splitmix64 finalizer, since class pointers are aligned and differ mostly in the middle bits
+            auto hash = reinterpret_cast<uint64_t>(class_ptr) ^ hook_id * 0x9E3779B97F4A7C15ULL;
+            hash = (hash ^ hash >> 30) * 0xBF58476D1CE4E5B9ULL;
+            hash = (hash ^ hash >> 27) * 0x94D049BB133111EBULL;
+            hash ^= hash >> 31;
+
+            return static_cast<size_t>(hash) & (size - 1);
+        }
+
+        size_t get_home_index(const void* class_ptr, const kb::hook::hook_id_t hook_id) const {
+            return get_home_index(slots.size(), class_ptr, hook_id);
+        }
+
+        // @return Index of the matching slot, or of the empty slot where it would be inserted
+        size_t probe(const void* class_ptr, const kb::hook::hook_id_t hook_id) const {
+            auto index = get_home_index(class_ptr, hook_id);
+
+            while(slots[index].class_ptr) {
+                if(slots[index].class_ptr == class_ptr && slots[index].hook_id == hook_id) {
+                    break;
+                }
+                index = (index + 1) & (slots.size() - 1);
+            }
+
+            return index;
+        }
+
+        mirror_t* add_mirror(const size_t size) {
+            return mirrors.emplace_back(new mirror_t{std::make_unique<mirror_slot_t[]>(size), size}).get();
+        }
+
+        void publish() {
+            const auto current_sequence = sequence.load(std::memory_order_relaxed);
+            sequence.store(current_sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            auto* target = mirror.load(std::memory_order_relaxed);
+            if(target->size != slots.size()) {
+                target = add_mirror(slots.size());
+            }
+
+            for(size_t i = 0; i < slots.size(); ++i) {
+                target->slots[i].class_ptr.store(slots[i].class_ptr, std::memory_order_relaxed);
+                target->slots[i].hook_id.store(slots[i].hook_id, std::memory_order_relaxed);
+                target->slots[i].orig_func_ptr.store(slots[i].data.orig_func_ptr, std::memory_order_relaxed);
+            }
+
+            mirror.store(target, std::memory_order_release);
+            sequence.store(current_sequence + 2, std::memory_order_release);
+        }
+
+        bool erase_unpublished(const void* class_ptr, const kb::hook::hook_id_t hook_id) {
+            auto hole = probe(class_ptr, hook_id);
+            if(not slots[hole].class_ptr) {
+                return false;
+            }
+
+            // Backward shift deletion, which keeps probing sequences intact without tombstones
+            const auto mask = slots.size() - 1;
+            for(auto index = (hole + 1) & mask; slots[index].class_ptr; index = (index + 1) & mask) {
+                const auto home = get_home_index(slots[index].class_ptr, slots[index].hook_id);
+
+                // Shift the entry only if the hole lies cyclically within [home, index)
+                if(((index - home) & mask) >= ((index - hole) & mask)) {
+                    slots[hole] = std::move(slots[index]);
+                    hole = index;
+                }
+            }
+
+            slots[hole] = {};
+            --count;
+
+            return true;
+        }
+
+        void grow() {
+            auto old_slots = std::exchange(slots, std::vector<slot_t>(slots.size() * 2));
+
+            for(auto& slot : old_slots) {
+                if(slot.class_ptr) {
+                    slots[probe(slot.class_ptr, slot.hook_id)] = std::move(slot);
+                }
+            }
+        }
+
+    public:
+        const hook_data_t* find(const void* class_ptr, const kb::hook::hook_id_t hook_id) const {
+            const auto& slot = slots[probe(class_ptr, hook_id)];
+
+            return slot.class_ptr ? &slot.data : nullptr;
+        }
+
+        hook_data_t* find(const void* class_ptr, const kb::hook::hook_id_t hook_id) {
+            auto& slot = slots[probe(class_ptr, hook_id)];
+
+            return slot.class_ptr ? &slot.data : nullptr;
+        }
+
+        void insert_or_assign(const void* class_ptr, const kb::hook::hook_id_t hook_id, hook_data_t data) {
+            // Load factor is kept under 3/4, where linear probing sequences stay short
+            if((count + 1) * 4 > slots.size() * 3) {
+                grow();
+            }
+
+            auto& slot = slots[probe(class_ptr, hook_id)];
+            if(not slot.class_ptr) {
+                ++count;
+            }
+
+            slot = {class_ptr, hook_id, std::move(data)};
+            publish();
+        }
+
+        bool erase(const void* class_ptr, const kb::hook::hook_id_t hook_id) {
+            if(not erase_unpublished(class_ptr, hook_id)) {
+                return false;
+            }
+
+            publish();
+            return true;
+        }
+
+        /** Removes every entry for which the predicate returns true. */
+        template<typename F>
+        size_t erase_if(F&& predicate) {
+            // Erasure shifts entries around, hence the keys are collected first
+            std::vector<std::pair<const void*, kb::hook::hook_id_t>> keys;
+            for(auto& slot : slots) {
+                if(slot.class_ptr && predicate(slot.class_ptr, slot.hook_id, slot.data)) {
+                    keys.emplace_back(slot.class_ptr, slot.hook_id);
+                }
+            }
+
+            for(const auto& [class_ptr, hook_id] : keys) {
+                erase_unpublished(class_ptr, hook_id);
+            }
+
+            if(not keys.empty()) {
+                publish();
+            }
+
+            return keys.size();
+        }
+
+        /**
+         * Safe to call without the registry lock. Keys are tried in the given order.
+         * @return Original function of the first hooked key, nullptr if none of them is hooked,
+         * or nothing if the table kept changing during the lookup, in which case the lock has to be taken.
+         */
+        std::optional<void*> find_orig_func(
+            const std::initializer_list<const void*> keys,
+            const kb::hook::hook_id_t hook_id
+        ) const {
+            // Writers are rare, hence a handful of attempts is plenty
+            for(int attempt = 0; attempt < 4; ++attempt) {
+                const auto start_sequence = sequence.load(std::memory_order_acquire);
+                if(start_sequence & 1) {
+                    continue;
+                }
+
+                const auto* const current = mirror.load(std::memory_order_acquire);
+                void* orig_func_ptr = nullptr;
+
+                for(const auto* const key : keys) {
+                    auto index = get_home_index(current->size, key, hook_id);
+
+                    // Bounded, since the slots may be inconsistent while a writer is busy
+                    for(size_t probes = 0; probes < current->size; ++probes) {
+                        const auto& slot = current->slots[index];
+
+                        const auto* const slot_class_ptr = slot.class_ptr.load(std::memory_order_relaxed);
+                        if(not slot_class_ptr) {
+                            break;
+                        }
+
+                        if(slot_class_ptr == key && slot.hook_id.load(std::memory_order_relaxed) == hook_id) {
+                            orig_func_ptr = slot.orig_func_ptr.load(std::memory_order_relaxed);
+                            break;
+                        }
+
+                        index = (index + 1) & (current->size - 1);
+                    }
+
+                    if(orig_func_ptr) {
+                        break;
+                    }
+                }
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if(sequence.load(std::memory_order_relaxed) == start_sequence) {
+                    return orig_func_ptr;
+                }
+            }
+
+            return std::nullopt;
+        }
+
+        bool contains_class(const void* class_ptr) const {
+            return std::ranges::any_of(
+                slots,
+                [&](const slot_t& slot) {
+                    return slot.class_ptr == class_ptr;
+                }
+            );
+        }
+
+        std::vector<kb::hook::hook_id_t> get_hook_ids(const void* class_ptr) const {
+            std::vector<kb::hook::hook_id_t> hook_ids;
+            for(const auto& slot : slots) {
+                if(slot.class_ptr == class_ptr) {
+                    hook_ids.push_back(slot.hook_id);
+                }
+            }
+
+            return hook_ids;
+        }
+    };
+
+    // Used for vtable swap hooks.
+    auto& get_vt_hook_table() {
+        // Never destroyed, since hooked functions may still be running during static destruction
+        static auto* const vt_hooks = new vt_hook_table();
+        return *vt_hooks;
     }
 
     auto& get_reverse_class_map() {
         // Used as a fallback mechanism when functions from different classes
         // end up being hooked with the same function. Normally we would use
-        // the class_map to get the class pointer first, but it may be missing
+        // the class pointer to find the hook, but it may be missing
         // in cases like late injection/hooking. Hence, as a last-resort method,
         // we could try using the last known class pointer in the hopes that it
-        // may be compatible. Key is function name.
-        static std::map<std::string, const void*> reverse_class_map = {};
+        // may be compatible. Key is hook id.
+        static std::unordered_map<kb::hook::hook_id_t, const void*> reverse_class_map = {};
         return reverse_class_map;
     }
 
     // Used for detours/eat hooks. Key is function name.
     auto& get_hook_map() {
-        static function_to_hook_data_map hook_map = {};
-        return hook_map;
+        // Never destroyed, since hooked functions may still be running during static destruction
+        static auto* const hook_map = new function_to_hook_data_map();
+        return *hook_map;
     }
 
-    const function_to_hook_data_map& find_function_map(
-        const void* class_ptr,
-        const std::string& function_name
-    ) {
-        const auto& class_map = get_class_map();
+    /**
+     * Single lock for the hook map, the class map and the reverse class map. Lookups come from hooked functions
+     * running on arbitrary threads, so they only take it in shared mode, while (un)installation takes it exclusively.
+     * Trampolines of detours are not guarded by it at all, since they are resolved through atomic slots.
+     */
+    std::shared_mutex& get_registry_mutex() {
+        static std::shared_mutex mutex;
+        return mutex;
+    }
+
+    struct hook_id_registry_t {
+        std::mutex mutex;
+        std::unordered_map<std::string, kb::hook::hook_id_t> ids;
+        std::vector<std::string> names; // Index is hook id
+    };
+
+    // Ids are never released, since call sites cache them for the lifetime of the process
+    hook_id_registry_t& get_hook_id_registry() {
+        static hook_id_registry_t registry;
+        return registry;
+    }
 
-        if(class_map.contains(class_ptr)) {
-            return class_map.at(class_ptr);
+    /**
+     * @return Object of the installed detour, or nullptr if the function could not be hooked.
+     */
+    hook_object_ptr install_detour(const void* address, const void* callback_function) {
+        hook_object_ptr object(get_hook_object_pool().create());
+        object->target = address;
+
+        auto& detour = object->detour.emplace(
+            reinterpret_cast<uint64_t>(address),
+            reinterpret_cast<uint64_t>(callback_function),
+            &object->trampoline
+        );
+
+#ifdef KB_64
+        detour.setDetourScheme(PLH::x64Detour::ALL);
+#endif
+        if(not detour.hook()) {
+            return nullptr;
         }
+
+        return object;
+    }
+
+    std::optional<kb::hook::hook_id_t> find_hook_id(const std::string& function_name) {
+        auto& registry = get_hook_id_registry();
+        const std::lock_guard lock(registry.mutex);
+
+        if(const auto it = registry.ids.find(function_name); it != registry.ids.end()) {
+            return it->second;
+        }
+
+        return std::nullopt;
+    }
+
+    struct instrumentation_epoch_t {
+        uint64_t timestamp;
+        std::chrono::steady_clock::time_point time;
+    };
+
+    std::mutex& get_instrumentation_epoch_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    // Timestamp counter frequency is not known upfront, so it is calibrated against the steady clock
+    instrumentation_epoch_t& get_instrumentation_epoch() {
+        static instrumentation_epoch_t epoch{};
+        return epoch;
+    }
+
+    double get_nanoseconds_per_tick() {
+        const std::lock_guard lock(get_instrumentation_epoch_mutex());
+
+        const auto& epoch = get_instrumentation_epoch();
+        const auto elapsed_ticks = kb::hook::details::read_timestamp() - epoch.timestamp;
+        const auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch.time
+        ).count();
+
+        if(epoch.timestamp == 0 || elapsed_ticks == 0 || elapsed_ns <= 0) {
+            return 0.0;
+        }
+
+        return static_cast<double>(elapsed_ns) / static_cast<double>(elapsed_ticks);
+    }
+
+    std::string get_hook_name(const kb::hook::hook_id_t hook_id) {
+        auto& registry = get_hook_id_registry();
+        const std::lock_guard lock(registry.mutex);
+
+        return hook_id < registry.names.size() ? registry.names[hook_id] : "<unknown>";
+    }
+
+    const void* get_vtable(const void* class_ptr) {
+        return static_cast<const kb::hook::virtual_class_t*>(class_ptr)->vtable;
+    }
+
+    /**
+     * Instance hooks take precedence, shared vtable hooks are consulted only if the instance has none.
+     * @return Hook data, or nullptr if neither the instance nor its vtable has the function hooked.
+     */
+    const hook_data_t* find_vt_hook_of(const void* class_ptr, const kb::hook::hook_id_t hook_id) {
+        const auto& vt_hooks = get_vt_hook_table();
+
+        if(const auto* hook_data = vt_hooks.find(class_ptr, hook_id)) {
+            return hook_data;
+        }
+
+        return vt_hooks.find(get_vtable(class_ptr), hook_id);
+    }
+
+    const hook_data_t& find_vt_hook(const void* class_ptr, const kb::hook::hook_id_t hook_id) {
+        const auto& vt_hooks = get_vt_hook_table();
+
+        if(const auto* hook_data = find_vt_hook_of(class_ptr, hook_id)) {
+            return *hook_data;
+        }
+
+        const auto function_name = get_hook_name(hook_id);
+
         LOG_ERROR(
-            "Hook map does not contain class pointer: {}.\n"
+            "Hook map does not contain function {} of class pointer: {}.\n"
             "Falling back to last known class pointer of {}.\n"
             "Most likely cause: {} has been loaded too late.",
+            function_name,
             class_ptr,
             function_name,
             kb::globals::get_project_name()
         );
 
         const auto& reverse_class_map = get_reverse_class_map();
-        if(reverse_class_map.contains(function_name)) {
-            const auto* fallback_class_ptr = reverse_class_map.at(function_name);
+        if(const auto it = reverse_class_map.find(hook_id); it != reverse_class_map.end()) {
+            const auto* fallback_class_ptr = it->second;
 
-            if(class_map.contains(fallback_class_ptr)) {
-                return class_map.at(fallback_class_ptr);
+            if(const auto* hook_data = vt_hooks.find(fallback_class_ptr, hook_id)) {
+                return *hook_data;
             }
 
             kb::util::panic(
@@ -113,23 +580,142 @@ namespace {
             std::format("Function '{}' was not found in the reverse class map", function_name)
         );
     }
+    /**
+     * @param hook_key Instance pointer for instance hooks, or vtable pointer for shared vtable hooks.
+     * @param is_shared Whether the vtable should be patched through a stand-in instance owned by the hook.
+     */
+    void install_vt_hook(
+        const void* hook_key,
+        const void* class_ptr,
+        const bool is_shared,
+        const std::string& function_name,
+        const uint16_t ordinal,
+        const void* callback_function
+    ) {
+        const auto hook_id = kb::hook::get_hook_id(function_name);
+
+        // The existing hook has swapped the vtable entry, so it is removed before the original is read
+        {
+            const std::unique_lock lock(get_registry_mutex());
+
+            auto& vt_hooks = get_vt_hook_table();
+            if(const auto* hook_data = vt_hooks.find(hook_key, hook_id)) {
+                LOG_WARN("Function '{}' of {} is already hooked. Replacing the existing hook.", function_name, hook_key);
+
+                if(not hook_data->object->get_hook().unHook()) {
+                    throw std::runtime_error(std::format("Failed to unhook existing hook of: {}", function_name));
+                }
+                vt_hooks.erase(hook_key, hook_id);
+            }
+        }
+
+        auto* const vtable = static_cast<const kb::hook::virtual_class_t*>(class_ptr)->vtable;
+        auto* const target_func = vtable[ordinal];
+
+        const PLH::VFuncMap redirect = {{ordinal, reinterpret_cast<uint64_t>(callback_function)}};
+
+        hook_object_ptr object(get_hook_object_pool().create());
+        object->target = target_func;
+        object->shared_class.vtable = vtable;
+
+        auto& swap_hook = object->swap_hook.emplace(
+            static_cast<const char*>(is_shared ? &object->shared_class : class_ptr),
+            redirect,
+            &object->original_functions
+        );
+
+        // The callback may be invoked by another thread as soon as the vtable entry is swapped,
+        // hence the original function has to be resolvable before that happens.
+        {
+            const std::unique_lock lock(get_registry_mutex());
+
+            get_vt_hook_table().insert_or_assign(
+                hook_key,
+                hook_id,
+                {
+                    .orig_func_ptr = target_func,
+                    .object = std::move(object),
+                }
+            );
+            get_reverse_class_map()[hook_id] = hook_key;
+        }
+
+        if(not swap_hook.hook()) {
+            const std::unique_lock lock(get_registry_mutex());
+
+            // Releases the hook object as well
+            get_vt_hook_table().erase(hook_key, hook_id);
+
+            if(auto& reverse_class_map = get_reverse_class_map(); reverse_class_map[hook_id] == hook_key) {
+                reverse_class_map.erase(hook_id);
+            }
+
+            throw std::runtime_error(std::format("Failed to hook function: {}", function_name));
+        }
+    }
 }
 
 namespace koalabox::hook {
+    namespace details {
+        std::atomic<void*> trampolines[MAX_HOOK_IDS] = {};
+
+        hook_counters_t hook_counters[MAX_HOOK_IDS] = {};
+        std::atomic<bool> is_instrumentation_enabled = false;
+        std::atomic<uint64_t> instrumentation_sample_mask = 0;
+
+        void panic_not_hooked(const hook_id_t hook_id) {
+            util::panic(std::format("Hook map does not contain function: {}", get_hook_name(hook_id)));
+        }
+
+        uint64_t read_timestamp() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+        }
+    }
+
+    hook_id_t get_hook_id(const std::string& function_name) {
+        auto& registry = get_hook_id_registry();
+        const std::lock_guard lock(registry.mutex);
+
+        if(const auto it = registry.ids.find(function_name); it != registry.ids.end()) {
+            return it->second;
+        }
+
+        if(registry.names.size() >= details::MAX_HOOK_IDS) {
+            throw std::runtime_error(
+                std::format("Hook id limit of {} reached while hooking: {}", details::MAX_HOOK_IDS, function_name)
+            );
+        }
+
+        const auto hook_id = static_cast<hook_id_t>(registry.names.size());
+        registry.names.push_back(function_name);
+        registry.ids.emplace(function_name, hook_id);
+
+        return hook_id;
+    }
+
     bool is_hooked(const std::string& function_name) {
+        const std::shared_lock lock(get_registry_mutex());
+
         return get_hook_map().contains(function_name);
     }
 
     bool is_vt_hooked(const void* class_ptr, const std::string& function_name) {
-        const auto& class_map = get_class_map();
+        const auto hook_id = find_hook_id(function_name);
+        if(not hook_id) {
+            return false;
+        }
+
+        const std::shared_lock lock(get_registry_mutex());
 
-        return class_map.contains(class_ptr) &&
-               class_map.at(class_ptr).contains(function_name);
+        return find_vt_hook_of(class_ptr, *hook_id) != nullptr;
     }
 
     bool unhook(const std::string& function_name) {
-        static std::mutex section;
-        const std::lock_guard lock(section);
+        const std::unique_lock lock(get_registry_mutex());
 
         auto& hook_map = get_hook_map();
 
@@ -138,10 +724,12 @@ namespace koalabox::hook {
             return false;
         }
 
-        const auto& hook_data = hook_map.at(function_name);
-        const auto success = hook_data.hook->unHook();
-        delete hook_data.hook;
-        delete hook_data.vfunc_map;
+        // Lookups must stop handing out the trampoline before it is freed
+        if(const auto hook_id = find_hook_id(function_name)) {
+            details::trampolines[*hook_id].store(nullptr, std::memory_order_release);
+        }
+
+        const auto success = hook_map.at(function_name).object->get_hook().unHook();
         hook_map.erase(function_name);
 
         LOG_DEBUG("{} -> Unhooked '{}'", __func__, function_name);
@@ -150,52 +738,127 @@ namespace koalabox::hook {
     }
 
     bool unhook_vt(const void* class_ptr, const std::string& function_name) {
-        static std::mutex section;
-        const std::lock_guard lock(section);
+        const std::unique_lock lock(get_registry_mutex());
 
-        auto& class_map = get_class_map();
+        auto& vt_hooks = get_vt_hook_table();
 
-        if(not class_map.contains(class_ptr)) {
+        if(not vt_hooks.contains_class(class_ptr) && not vt_hooks.contains_class(get_vtable(class_ptr))) {
             LOG_ERROR("Cannot unhook '{}'. Class pointer not found: {}", function_name, class_ptr)
             return false;
         }
 
-        auto& function_map = class_map.at(class_ptr);
+        const auto hook_id = find_hook_id(function_name);
+        const auto* hook_data_ptr = hook_id ? vt_hooks.find(class_ptr, *hook_id) : nullptr;
+        const auto* hook_key = class_ptr;
+
+        if(hook_id && not hook_data_ptr) {
+            hook_key = get_vtable(class_ptr);
+            hook_data_ptr = vt_hooks.find(hook_key, *hook_id);
+        }
 
-        if(not function_map.contains(function_name)) {
+        if(not hook_data_ptr) {
             LOG_ERROR("Cannot unhook '{}'. Function name not found", function_name);
             return false;
         }
 
-        const auto& hook_data = function_map.at(function_name);
-        const auto success = hook_data.hook->unHook();
-        delete hook_data.hook;
-        delete hook_data.vfunc_map;
-        function_map.erase(function_name);
-        get_reverse_class_map().erase(function_name);
+        const auto success = hook_data_ptr->object->get_hook().unHook();
+        vt_hooks.erase(hook_key, *hook_id);
+        get_reverse_class_map().erase(*hook_id);
 
-        LOG_DEBUG("{} -> Unhooked '{}' from {}", __func__, function_name, class_ptr);
+        LOG_DEBUG("{} -> Unhooked '{}' from {}", __func__, function_name, hook_key);
 
         return success;
     }
 
     bool unhook_vt_all(const void* class_ptr) {
-        static std::mutex section;
-        const std::lock_guard lock(section);
+        const std::unique_lock lock(get_registry_mutex());
 
-        auto& class_map = get_class_map();
+        auto& vt_hooks = get_vt_hook_table();
 
-        if(not class_map.contains(class_ptr)) {
+        const auto hook_ids = vt_hooks.get_hook_ids(class_ptr);
+        if(hook_ids.empty()) {
             LOG_ERROR("Unhooking error. Class pointer not found: {}", class_ptr)
             return false;
         }
 
-        // This should call the destructor of hooked functions, which will unhook them.
-        class_map.erase(class_ptr);
+        auto success = true;
+        for(const auto hook_id : hook_ids) {
+            if(not vt_hooks.find(class_ptr, hook_id)->object->get_hook().unHook()) {
+                LOG_ERROR("Failed to unhook '{}' from {}", get_hook_name(hook_id), class_ptr);
+                success = false;
+            }
+
+            vt_hooks.erase(class_ptr, hook_id);
+        }
 
         LOG_DEBUG("{} -> Unhooked all functions from {}", __func__, class_ptr);
 
-        return true;
+        return success;
+    }
+
+    size_t forget_hooks_in_range(const void* start_address, const void* end_address) {
+        const auto is_in_range = [&](const void* address) {
+            return address >= start_address && address < end_address;
+        };
+
+        // Destroying a hook restores the original bytes of the function, whose memory is gone by now.
+        // Hence, the hook objects are deliberately leaked instead.
+        const auto forget = [](hook_data_t& hook_data) {
+            [[maybe_unused]] const auto* const leaked_object = hook_data.object.release();
+        };
+
+        size_t count = 0;
+        {
+            const std::unique_lock lock(get_registry_mutex());
+
+            auto& hook_map = get_hook_map();
+            for(auto it = hook_map.begin(); it != hook_map.end();) {
+                auto& [function_name, hook_data] = *it;
+                if(not is_in_range(hook_data.object->target)) {
+                    ++it;
+                    continue;
+                }
+
+                if(const auto hook_id = find_hook_id(function_name)) {
+                    details::trampolines[*hook_id].store(nullptr, std::memory_order_release);
+                }
+
+                LOG_DEBUG("{} -> Forgetting hook of '{}' at {}", __func__, function_name, hook_data.object->target);
+
+                forget(hook_data);
+                it = hook_map.erase(it);
+                ++count;
+            }
+
+            // Instances and vtables of classes that the module defined are gone as well
+            count += get_vt_hook_table().erase_if(
+                [&](const void* hook_key, kb::hook::hook_id_t, hook_data_t& hook_data) {
+                    if(not is_in_range(hook_key) && not is_in_range(hook_data.object->target)) {
+                        return false;
+                    }
+
+                    forget(hook_data);
+                    return true;
+                }
+            );
+
+            std::erase_if(
+                get_reverse_class_map(),
+                [&](const auto& entry) {
+                    return is_in_range(entry.second);
+                }
+            );
+        }
+
+#if defined(KB_LINUX)
+        count += details::forget_import_hooks_in_range(start_address, end_address);
+#endif
+
+        if(count) {
+            LOG_DEBUG("Forgot {} hooks in range [{}, {})", count, start_address, end_address);
+        }
+
+        return count;
     }
 
     void detour_or_throw(
@@ -209,29 +872,169 @@ namespace koalabox::hook {
 
         LOG_DEBUG("Hooking '{}' at {} via Detour", function_name, address);
 
-        uint64_t trampoline = 0;
-
-        // False flag - no memory is actually leaked, it is freed in unhook
-        // ReSharper disable once CppDFAMemoryLeak
-        auto* const detour = new PLH::NatDetour(
-            reinterpret_cast<uint64_t>(address),
-            reinterpret_cast<uint64_t>(callback_function),
-            &trampoline
-        );
+        // Interned before patching anything, so that running out of ids cannot leave a dangling hook
+        const auto hook_id = get_hook_id(function_name);
 
-#ifdef KB_64
-        detour->setDetourScheme(PLH::x64Detour::ALL);
+#if defined(KB_LINUX)
+        // Import hooks publish their original function through the same trampoline slot
+        if(details::is_import_hooked(function_name)) {
+            throw std::runtime_error(std::format("Function '{}' is already hooked via import", function_name));
+        }
 #endif
-        if(detour->hook()) {
-            get_hook_map()[function_name] = {
-                .orig_func_ptr = reinterpret_cast<void*>(trampoline),
-                .vfunc_map = new PLH::VFuncMap{},
-                .hook = detour,
-            };
-        } else {
-            delete detour;
+
+        // Otherwise, the new entry would replace the existing one and destroy its still installed hook
+        if(is_hooked(function_name)) {
+            LOG_WARN("Function '{}' is already hooked. Replacing the existing hook.", function_name);
+
+            if(not unhook(function_name)) {
+                throw std::runtime_error(std::format("Failed to unhook existing hook of: {}", function_name));
+            }
+        }
+
+        auto object = install_detour(address, callback_function);
+        if(not object) {
             throw std::runtime_error(std::format("Failed to hook function: {}", function_name));
         }
+
+        auto* const trampoline = reinterpret_cast<void*>(object->trampoline);
+
+        const std::unique_lock lock(get_registry_mutex());
+
+        if(not get_hook_map().try_emplace(function_name, trampoline, std::move(object)).second) {
+            // Another thread hooked the same function in the meantime. The object is left intact by try_emplace.
+            object->get_hook().unHook();
+            throw std::runtime_error(std::format("Function '{}' was hooked concurrently", function_name));
+        }
+        details::trampolines[hook_id].store(trampoline, std::memory_order_release);
+    }
+
+    void detour_batch_or_throw(const std::vector<detour_entry_t>& entries) {
+        // Everything that can be validated is validated before the first byte is patched
+        std::set<std::string> names;
+        std::set<const void*> addresses;
+        std::vector<hook_id_t> hook_ids;
+        hook_ids.reserve(entries.size());
+
+        for(const auto& [address, function_name, callback_function] : entries) {
+            if(not names.insert(function_name).second) {
+                throw std::runtime_error(std::format("Function '{}' appears in the batch more than once", function_name));
+            }
+            if(not addresses.insert(address).second) {
+                throw std::runtime_error(std::format("Address {} of '{}' is already in the batch", address, function_name));
+            }
+            if(is_hooked(function_name)) {
+                throw std::runtime_error(std::format("Function '{}' is already hooked", function_name));
+            }
+#if defined(KB_LINUX)
+            if(details::is_import_hooked(function_name)) {
+                throw std::runtime_error(std::format("Function '{}' is already hooked via import", function_name));
+            }
+#endif
+
+            hook_ids.push_back(get_hook_id(function_name));
+        }
+
+        // Hooks on the same page are installed back to back, which keeps the page hot between protection changes
+        std::vector<size_t> install_order(entries.size());
+        std::iota(install_order.begin(), install_order.end(), size_t{0});
+        std::ranges::sort(
+            install_order,
+            [&](const size_t a, const size_t b) {
+                return entries[a].address < entries[b].address;
+            }
+        );
+
+        std::vector<std::pair<size_t, hook_object_ptr>> installed;
+        installed.reserve(entries.size());
+
+        // Must be called with the registry lock held. Slots of functions that another thread has hooked
+        // in the meantime are handed back to that thread's trampoline rather than cleared.
+        const auto roll_back = [&] {
+            const auto& hook_map = get_hook_map();
+
+            for(const auto& [index, object] : std::views::reverse(installed)) {
+                const auto& function_name = entries[index].function_name;
+
+                // Unhooked before the slot is cleared, so that the callback is never entered without a trampoline
+                if(not object->get_hook().unHook()) {
+                    LOG_ERROR("Failed to roll back detour of '{}'", function_name);
+                }
+
+                const auto it = hook_map.find(function_name);
+                details::trampolines[hook_ids[index]].store(
+                    it != hook_map.end() ? it->second.orig_func_ptr : nullptr,
+                    std::memory_order_release
+                );
+            }
+        };
+
+        for(const auto index : install_order) {
+            const auto& [address, function_name, callback_function] = entries[index];
+
+            LOG_DEBUG("Hooking '{}' at {} via Detour (batch)", function_name, address);
+
+            auto object = install_detour(address, callback_function);
+            if(not object) {
+                LOG_ERROR("Failed to hook '{}'. Rolling back {} installed detours.", function_name, installed.size());
+
+                {
+                    const std::unique_lock lock(get_registry_mutex());
+                    roll_back();
+                }
+
+                throw std::runtime_error(std::format("Failed to hook function: {}", function_name));
+            }
+
+            // Published right away, since the callback may be invoked before the batch completes
+            details::trampolines[hook_ids[index]].store(
+                reinterpret_cast<void*>(object->trampoline),
+                std::memory_order_release
+            );
+            installed.emplace_back(index, std::move(object));
+        }
+
+        const std::unique_lock lock(get_registry_mutex());
+
+        auto& hook_map = get_hook_map();
+
+        // Checked again under the lock, since another thread may have hooked one of the functions in the meantime.
+        // The whole batch is registered only once it is clear that no existing entry would be replaced.
+        for(const auto& [index, object] : installed) {
+            if(const auto& function_name = entries[index].function_name; hook_map.contains(function_name)) {
+                LOG_ERROR(
+                    "Function '{}' was hooked concurrently. Rolling back {} installed detours.",
+                    function_name,
+                    installed.size()
+                );
+
+                roll_back();
+
+                throw std::runtime_error(std::format("Function '{}' was hooked concurrently", function_name));
+            }
+        }
+
+        for(auto& [index, object] : installed) {
+            auto* const trampoline = reinterpret_cast<void*>(object->trampoline);
+            hook_map.try_emplace(entries[index].function_name, trampoline, std::move(object));
+        }
+
+        LOG_DEBUG("Installed a batch of {} detours", installed.size());
+    }
+
+    void detour_batch_or_warn(const std::vector<detour_entry_t>& entries) {
+        try {
+            detour_batch_or_throw(entries);
+        } catch(const std::exception& ex) {
+            LOG_WARN("Batch detour error: {}", ex.what());
+        }
+    }
+
+    void detour_batch(const std::vector<detour_entry_t>& entries) {
+        try {
+            detour_batch_or_throw(entries);
+        } catch(const std::exception& ex) {
+            util::panic(std::format("Failed to install a batch of {} detours: {}", entries.size(), ex.what()));
+        }
     }
 
     void detour_module_or_throw(
@@ -239,7 +1042,7 @@ namespace koalabox::hook {
         const std::string& function_name,
         const void* callback_function
     ) {
-        const auto* address = lib::get_function_address(module_handle, function_name.c_str()).value();
+        const auto* address = lib::find_function_address(module_handle, function_name).value();
 
         detour_or_throw(address, function_name, callback_function);
     }
@@ -318,32 +1121,42 @@ namespace koalabox::hook {
 
         LOG_DEBUG("Hooking {} via virtual function swap", func_data);
 
-        const PLH::VFuncMap redirect = {{ordinal, reinterpret_cast<uint64_t>(callback_function)}};
+        install_vt_hook(class_ptr, class_ptr, false, function_name, ordinal, callback_function);
+    }
 
-        // False positive - No memory is actually leaked, it is freed in unhook_vt
-        // ReSharper disable once CppDFAMemoryLeak
-        auto* original_functions = new PLH::VFuncMap();
+    void swap_shared_virtual_func_or_throw(
+        const void* class_ptr,
+        const std::string& function_name,
+        const uint16_t ordinal,
+        const void* callback_function
+    ) {
+        auto** const vtable = static_cast<const virtual_class_t*>(class_ptr)->vtable;
 
-        // False positive - No memory is actually leaked, it is freed in unhook_vt
-        // ReSharper disable once CppDFAMemoryLeak
-        auto* const swap_hook = new PLH::VFuncSwapHook(
-            static_cast<const char*>(class_ptr),
-            redirect,
-            original_functions
+        const auto func_data = std::format(
+            "'{}' @ [{}+0x{:X}]",
+            function_name,
+            static_cast<const void*>(vtable),
+            ordinal * sizeof(void*)
         );
 
-        if(swap_hook->hook()) {
-            get_class_map()[class_ptr][function_name] = {
-                .orig_func_ptr = reinterpret_cast<void*>((*original_functions)[ordinal]),
-                .vfunc_map = original_functions,
-                .hook = swap_hook,
-            };
-            get_reverse_class_map()[function_name] = class_ptr;
-        } else {
-            delete swap_hook;
-            delete original_functions;
-            throw std::runtime_error(std::format("Failed to hook function: {}", function_name));
+        const auto hook_id = get_hook_id(function_name);
+        {
+            const std::shared_lock lock(get_registry_mutex());
+
+            if(get_vt_hook_table().find(vtable, hook_id)) {
+                LOG_TRACE("Function {} is already hooked. Skipping shared virtual function swap", func_data);
+                return;
+            }
+        }
+
+        if(vtable[ordinal] == callback_function) {
+            LOG_DEBUG("Function {} is already hooked. Skipping shared virtual function swap", func_data);
+            return;
         }
+
+        LOG_DEBUG("Hooking {} via shared virtual function swap", func_data);
+
+        install_vt_hook(vtable, class_ptr, true, function_name, ordinal, callback_function);
     }
 
     void swap_virtual_func(
@@ -370,31 +1183,160 @@ namespace koalabox::hook {
         }
     }
 
-    void* get_hooked_function_address(const std::string& function_name) {
-        const auto& hook_map = get_hook_map();
+    void swap_shared_virtual_func(
+        const void* class_ptr,
+        const std::string& function_name,
+        const uint16_t ordinal,
+        const void* callback_function
+    ) {
+        try {
+            swap_shared_virtual_func_or_throw(
+                class_ptr,
+                function_name,
+                ordinal,
+                callback_function
+            );
+        } catch(const std::exception& ex) {
+            util::panic(
+                std::format(
+                    "Failed to hook function {} via shared virtual function swap: {}",
+                    function_name,
+                    ex.what()
+                )
+            );
+        }
+    }
 
-        if(not hook_map.contains(function_name)) {
+    void* get_hooked_function_address(const std::string& function_name) {
+        const auto hook_id = find_hook_id(function_name);
+        if(not hook_id) {
             util::panic(
                 std::format("Hook map does not contain function: {}", function_name)
             );
         }
 
-        return hook_map.at(function_name).orig_func_ptr;
+        return get_hooked_function_address(*hook_id);
     }
 
     void* get_swapped_function_address(
         const void* class_ptr,
         const std::string& function_name
     ) {
-        const auto& function_map = find_function_map(class_ptr, function_name);
-
-        if(not function_map.contains(function_name)) {
+        const auto hook_id = find_hook_id(function_name);
+        if(not hook_id) {
             util::panic(
                 std::format("Function hook map does not contain function: {}", function_name)
             );
         }
 
-        return function_map.at(function_name).orig_func_ptr;
+        return get_swapped_function_address(class_ptr, *hook_id);
+    }
+
+    void* get_swapped_function_address(const void* class_ptr, const hook_id_t hook_id) {
+        // Hooked functions call this on every invocation, hence the common case does not take the registry lock.
+        // Instance hooks take precedence, just like in find_vt_hook.
+        const auto orig_func_ptr = get_vt_hook_table().find_orig_func({class_ptr, get_vtable(class_ptr)}, hook_id);
+        if(orig_func_ptr && *orig_func_ptr) {
+            return *orig_func_ptr;
+        }
+
+        // Either the table was busy, or the lookup has to fall back to the last known class pointer
+        const std::shared_lock lock(get_registry_mutex());
+
+        return find_vt_hook(class_ptr, hook_id).orig_func_ptr;
+    }
+
+    void enable_instrumentation(const uint32_t sample_interval) {
+        {
+            const std::lock_guard lock(get_instrumentation_epoch_mutex());
+            get_instrumentation_epoch() = {details::read_timestamp(), std::chrono::steady_clock::now()};
+        }
+
+        details::instrumentation_sample_mask = std::bit_ceil(std::max(sample_interval, 1U)) - 1;
+        details::is_instrumentation_enabled = true;
+
+        LOG_DEBUG("Hook instrumentation enabled. Sample interval: {}", details::instrumentation_sample_mask + 1);
+    }
+
+    void disable_instrumentation() {
+        details::is_instrumentation_enabled = false;
+
+        LOG_DEBUG("Hook instrumentation disabled");
+    }
+
+    void reset_instrumentation() {
+        for(auto& counters : details::hook_counters) {
+            counters.call_count.store(0, std::memory_order_relaxed);
+            counters.sampled_call_count.store(0, std::memory_order_relaxed);
+            counters.sampled_ticks.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    std::vector<hook_stats_t> get_instrumentation_snapshot(const stats_order order) {
+        const auto ns_per_tick = get_nanoseconds_per_tick();
+
+        std::vector<std::string> names;
+        {
+            auto& registry = get_hook_id_registry();
+            const std::lock_guard lock(registry.mutex);
+            names = registry.names;
+        }
+
+        std::vector<hook_stats_t> snapshot;
+        for(hook_id_t hook_id = 0; hook_id < names.size(); ++hook_id) {
+            const auto& counters = details::hook_counters[hook_id];
+
+            const auto call_count = counters.call_count.load(std::memory_order_relaxed);
+            if(call_count == 0) {
+                continue;
+            }
+
+            const auto sampled_call_count = counters.sampled_call_count.load(std::memory_order_relaxed);
+            const auto sampled_ticks = counters.sampled_ticks.load(std::memory_order_relaxed);
+
+            const auto average_ns = sampled_call_count
+                                        ? static_cast<double>(sampled_ticks) * ns_per_tick / sampled_call_count
+                                        : 0.0;
+
+            snapshot.push_back(
+                {
+                    .function_name = names[hook_id],
+                    .call_count = call_count,
+                    .sampled_call_count = sampled_call_count,
+                    .total_time = std::chrono::nanoseconds(static_cast<int64_t>(average_ns * call_count)),
+                    .average_time = std::chrono::nanoseconds(static_cast<int64_t>(average_ns)),
+                }
+            );
+        }
+
+        std::ranges::sort(
+            snapshot,
+            [&](const hook_stats_t& a, const hook_stats_t& b) {
+                if(order == stats_order::total_time) {
+                    return std::tie(a.total_time, a.call_count) > std::tie(b.total_time, b.call_count);
+                }
+                return std::tie(a.call_count, a.total_time) > std::tie(b.call_count, b.total_time);
+            }
+        );
+
+        return snapshot;
+    }
+
+    void log_instrumentation_snapshot(const stats_order order) {
+        const auto snapshot = get_instrumentation_snapshot(order);
+
+        LOG_INFO("Hook instrumentation snapshot of {} hooks:", snapshot.size());
+        LOG_INFO("{:>12} {:>12} {:>12}  {}", "Calls", "Total (us)", "Average (ns)", "Function");
+
+        for(const auto& stats : snapshot) {
+            LOG_INFO(
+                "{:>12} {:>12} {:>12}  {}",
+                stats.call_count,
+                std::chrono::duration_cast<std::chrono::microseconds>(stats.total_time).count(),
+                stats.average_time.count(),
+                stats.function_name
+            );
+        }
     }
 
     void init(bool print_info) {
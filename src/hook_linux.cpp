@@ -0,0 +1,453 @@
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <dlfcn.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "koalabox/hook.hpp"
+#include "koalabox/logger.hpp"
+#include "koalabox/util.hpp"
+
+namespace {
+    namespace kb = koalabox;
+
+    struct import_slot_t {
+        void** address;
+        void* original_value; // May be a PLT stub if the slot has not been lazily bound yet
+    };
+
+    struct import_hook_t {
+        kb::hook::hook_id_t hook_id;
+        std::vector<import_slot_t> slots;
+    };
+
+    // Key is (module handle, function name)
+    using import_hook_map = std::map<std::pair<void*, std::string>, import_hook_t>;
+
+    import_hook_map& get_import_hook_map() {
+        static import_hook_map import_hooks;
+        return import_hooks;
+    }
+
+    std::mutex& get_import_hook_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    /**
+     * Import hooks of the same function in different modules share the trampoline slot of its hook id,
+     * hence the slot is cleared only once the last of them is gone. Must be called with the import hook mutex held.
+     */
+    void release_trampoline(const kb::hook::hook_id_t hook_id) {
+        const auto is_in_use = std::ranges::any_of(
+            get_import_hook_map(),
+            [&](const auto& entry) {
+                return entry.second.hook_id == hook_id;
+            }
+        );
+
+        if(not is_in_use) {
+            kb::hook::details::trampolines[hook_id].store(nullptr, std::memory_order_release);
+        }
+    }
+
+    struct dynamic_info_t {
+        ElfW(Addr) base = 0;
+        const ElfW(Dyn)* dynamic = nullptr;
+        const ElfW(Sym)* symbols = nullptr;
+        const char* strings = nullptr;
+        // Relocation tables in which GOT slots of imported functions can be found
+        std::vector<std::pair<const uint8_t*, size_t>> relocation_tables;
+        bool is_rela = true;
+        // PT_GNU_RELRO range, which is read-only after relocation. Like the loader, the end is aligned down,
+        // since the last partial page is shared with writable data and hence stays writable.
+        ElfW(Addr) relro_start = 0;
+        ElfW(Addr) relro_end = 0;
+    };
+
+    std::optional<dynamic_info_t> read_dynamic_info(void* module_handle) {
+        link_map* lm;
+        if(dlinfo(module_handle, RTLD_DI_LINKMAP, &lm) != 0) { // NOLINT(*-multi-level-implicit-pointer-conversion)
+            LOG_ERROR("Failed to get link_map from module handle: {}", module_handle);
+            return std::nullopt;
+        }
+
+        dynamic_info_t info{.base = lm->l_addr, .dynamic = lm->l_ld};
+
+        // glibc relocates the dynamic section entries in place, other loaders may not
+        const auto to_address = [&](const ElfW(Addr) value) {
+            return value < info.base ? info.base + value : value;
+        };
+
+        ElfW(Addr) jmprel = 0, rela = 0, rel = 0;
+        size_t jmprel_size = 0, rela_size = 0, rel_size = 0;
+
+        for(const auto* dyn = lm->l_ld; dyn->d_tag != DT_NULL; ++dyn) {
+            switch(dyn->d_tag) {
+            case DT_SYMTAB: info.symbols = reinterpret_cast<const ElfW(Sym)*>(to_address(dyn->d_un.d_ptr));
+                break;
+            case DT_STRTAB: info.strings = reinterpret_cast<const char*>(to_address(dyn->d_un.d_ptr));
+                break;
+            case DT_JMPREL: jmprel = to_address(dyn->d_un.d_ptr);
+                break;
+            case DT_PLTRELSZ: jmprel_size = dyn->d_un.d_val;
+                break;
+            case DT_PLTREL: info.is_rela = dyn->d_un.d_val == DT_RELA;
+                break;
+            case DT_RELA: rela = to_address(dyn->d_un.d_ptr);
+                break;
+            case DT_RELASZ: rela_size = dyn->d_un.d_val;
+                break;
+            case DT_REL: rel = to_address(dyn->d_un.d_ptr);
+                break;
+            case DT_RELSZ: rel_size = dyn->d_un.d_val;
+                break;
+            default: break;
+            }
+        }
+
+        if(not info.symbols || not info.strings) {
+            LOG_ERROR("Module {} has no dynamic symbol table", module_handle);
+            return std::nullopt;
+        }
+
+        // PLT relocations use the same format as the rest, so both tables are parsed the same way
+        if(jmprel) {
+            info.relocation_tables.emplace_back(reinterpret_cast<const uint8_t*>(jmprel), jmprel_size);
+        }
+        if(info.is_rela && rela) {
+            info.relocation_tables.emplace_back(reinterpret_cast<const uint8_t*>(rela), rela_size);
+        }
+        if(not info.is_rela && rel) {
+            info.relocation_tables.emplace_back(reinterpret_cast<const uint8_t*>(rel), rel_size);
+        }
+
+        struct context_t {
+            dynamic_info_t& info;
+            const link_map* lm;
+        } context{info, lm};
+
+        dl_iterate_phdr(
+            [](dl_phdr_info* const phdr_info, size_t, void* data) {
+                auto* const ctx = static_cast<context_t*>(data);
+                if(phdr_info->dlpi_addr != ctx->lm->l_addr) {
+                    return 0;
+                }
+
+                for(int i = 0; i < phdr_info->dlpi_phnum; ++i) {
+                    if(const auto& phdr = phdr_info->dlpi_phdr[i]; phdr.p_type == PT_GNU_RELRO) {
+                        static const auto page_size = static_cast<ElfW(Addr)>(sysconf(_SC_PAGESIZE));
+
+                        ctx->info.relro_start = phdr_info->dlpi_addr + phdr.p_vaddr;
+                        ctx->info.relro_end = (ctx->info.relro_start + phdr.p_memsz) & ~(page_size - 1);
+                    }
+                }
+
+                return 1;
+            }, &context
+        );
+
+        return info;
+    }
+
+    template<typename Relocation>
+    void collect_slots(
+        const dynamic_info_t& info,
+        const std::pair<const uint8_t*, size_t>& table,
+        const std::string& function_name,
+        std::vector<void**>& slots
+    ) {
+        const auto* const relocations = reinterpret_cast<const Relocation*>(table.first);
+        const auto count = table.second / sizeof(Relocation);
+
+        for(size_t i = 0; i < count; ++i) {
+            const auto& relocation = relocations[i];
+
+#ifdef KB_64
+            const auto type = ELF64_R_TYPE(relocation.r_info);
+            const auto symbol_index = ELF64_R_SYM(relocation.r_info);
+            const auto is_slot = type == R_X86_64_JUMP_SLOT || type == R_X86_64_GLOB_DAT;
+#else
+            const auto type = ELF32_R_TYPE(relocation.r_info);
+            const auto symbol_index = ELF32_R_SYM(relocation.r_info);
+            const auto is_slot = type == R_386_JMP_SLOT || type == R_386_GLOB_DAT;
+#endif
+
+            if(not is_slot || symbol_index == 0) {
+                continue;
+            }
+
+            if(function_name == info.strings + info.symbols[symbol_index].st_name) {
+                auto** const slot = reinterpret_cast<void**>(info.base + relocation.r_offset);
+                if(std::ranges::find(slots, slot) == slots.end()) {
+                    slots.push_back(slot);
+                }
+            }
+        }
+    }
+
+    /**
+     * @return Protection flags of the mapping that contains the address, as listed in /proc/self/maps.
+     */
+    std::optional<int> get_protection(const uintptr_t address) {
+        auto* const maps = std::fopen("/proc/self/maps", "r");
+        if(!maps) {
+            return std::nullopt;
+        }
+
+        std::optional<int> protection;
+
+        unsigned long start, end;
+        char permissions[5];
+        while(std::fscanf(maps, "%lx-%lx %4s %*[^\n]", &start, &end, permissions) == 3) {
+            if(address >= start && address < end) {
+                protection = (permissions[0] == 'r' ? PROT_READ : 0) |
+                             (permissions[1] == 'w' ? PROT_WRITE : 0) |
+                             (permissions[2] == 'x' ? PROT_EXEC : 0);
+                break;
+            }
+        }
+
+        std::fclose(maps);
+
+        return protection;
+    }
+
+    /**
+     * Stores the value in a GOT slot, temporarily making RELRO pages writable.
+     * The store itself is atomic, so concurrent callers see either the old or the new target.
+     */
+    bool write_slot(const dynamic_info_t& info, void** slot, void* value) {
+        const auto address = reinterpret_cast<ElfW(Addr)>(slot);
+        const auto is_relro = address >= info.relro_start && address < info.relro_end;
+
+        static const auto page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        auto* const page = reinterpret_cast<void*>(address & ~(page_size - 1));
+
+        // The exact protection is restored afterwards, rather than assuming what the loader has left behind
+        const auto protection = is_relro ? get_protection(address) : std::nullopt;
+        const auto is_read_only = protection && !(*protection & PROT_WRITE);
+
+        if(is_relro && !protection) {
+            LOG_ERROR("Failed to read protection of GOT slot {}", static_cast<void*>(slot));
+            return false;
+        }
+
+        if(is_read_only && mprotect(page, page_size, *protection | PROT_WRITE) != 0) {
+            LOG_ERROR("Failed to make GOT slot {} writable", static_cast<void*>(slot));
+            return false;
+        }
+
+        __atomic_store_n(slot, value, __ATOMIC_RELEASE);
+
+        if(is_read_only && mprotect(page, page_size, *protection) != 0) {
+            LOG_WARN("Failed to restore protection of GOT slot {}", static_cast<void*>(slot));
+        }
+
+        return true;
+    }
+
+    /**
+     * Slots that have not been bound yet point back into the PLT of the module,
+     * hence the actual function has to be resolved the same way the dynamic linker would.
+     * The global scope may yield an interposing export, possibly even our own, so the lookup
+     * is confined to the module and its dependencies.
+     */
+    void* resolve_original_function(
+        void* module_handle,
+        const dynamic_info_t& info,
+        const std::string& function_name,
+        void* slot_value
+    ) {
+        Dl_info slot_info{};
+        Dl_info module_info{};
+
+        const auto points_into_module = dladdr(slot_value, &slot_info) &&
+                                        dladdr(info.dynamic, &module_info) &&
+                                        slot_info.dli_fbase == module_info.dli_fbase;
+
+        if(not points_into_module) {
+            return slot_value;
+        }
+
+        return dlsym(module_handle, function_name.c_str());
+    }
+}
+
+namespace koalabox::hook {
+    void hook_import_or_throw(
+        void* module_handle,
+        const std::string& function_name,
+        const void* callback_function
+    ) {
+        const auto info = read_dynamic_info(module_handle);
+        if(not info) {
+            throw std::runtime_error(std::format("Failed to read dynamic section of module {}", module_handle));
+        }
+
+        std::vector<void**> slots;
+        for(const auto& table : info->relocation_tables) {
+            if(info->is_rela) {
+                collect_slots<ElfW(Rela)>(*info, table, function_name, slots);
+            } else {
+                collect_slots<ElfW(Rel)>(*info, table, function_name, slots);
+            }
+        }
+
+        if(slots.empty()) {
+            throw std::runtime_error(
+                std::format("Module {} does not import function: {}", module_handle, function_name)
+            );
+        }
+
+        const std::lock_guard lock(get_import_hook_mutex());
+
+        const auto key = std::make_pair(module_handle, function_name);
+        if(get_import_hook_map().contains(key)) {
+            LOG_DEBUG("Import '{}' of module {} is already hooked. Skipping.", function_name, module_handle);
+            return;
+        }
+
+        // Both kinds of hooks publish their original function through the same trampoline slot
+        if(is_hooked(function_name)) {
+            throw std::runtime_error(std::format("Function '{}' is already hooked via detour", function_name));
+        }
+
+        LOG_DEBUG("Hooking import '{}' of module {} via {} GOT slot(s)", function_name, module_handle, slots.size());
+
+        import_hook_t import_hook{.hook_id = get_hook_id(function_name)};
+
+        auto* const original_function = resolve_original_function(module_handle, *info, function_name, *slots.front());
+        if(not original_function) {
+            throw std::runtime_error(std::format("Failed to resolve original function: {}", function_name));
+        }
+        if(original_function == callback_function) {
+            throw std::runtime_error(std::format("Original function of '{}' resolves to its callback", function_name));
+        }
+
+        // The callback may run as soon as the first slot is written, so the original must be resolvable by then.
+        // If the function is hooked in another module already, its original is kept.
+        void* expected_trampoline = nullptr;
+        details::trampolines[import_hook.hook_id].compare_exchange_strong(
+            expected_trampoline,
+            original_function,
+            std::memory_order_acq_rel
+        );
+
+        for(auto** const slot : slots) {
+            auto* const original_value = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+
+            if(not write_slot(*info, slot, const_cast<void*>(callback_function))) {
+                for(const auto& [address, value] : import_hook.slots) {
+                    write_slot(*info, address, value);
+                }
+                release_trampoline(import_hook.hook_id);
+
+                throw std::runtime_error(std::format("Failed to patch GOT slot of function: {}", function_name));
+            }
+
+            import_hook.slots.push_back({slot, original_value});
+        }
+
+        get_import_hook_map().emplace(key, std::move(import_hook));
+    }
+
+    void hook_import(
+        void* module_handle,
+        const std::string& function_name,
+        const void* callback_function
+    ) {
+        try {
+            hook_import_or_throw(module_handle, function_name, callback_function);
+        } catch(const std::exception& ex) {
+            util::panic(
+                std::format("Failed to hook import {} via GOT: {}", function_name, ex.what())
+            );
+        }
+    }
+
+    bool is_import_hooked(void* module_handle, const std::string& function_name) {
+        const std::lock_guard lock(get_import_hook_mutex());
+
+        return get_import_hook_map().contains({module_handle, function_name});
+    }
+
+    bool unhook_import(void* module_handle, const std::string& function_name) {
+        const std::lock_guard lock(get_import_hook_mutex());
+
+        auto& import_hooks = get_import_hook_map();
+
+        const auto it = import_hooks.find({module_handle, function_name});
+        if(it == import_hooks.end()) {
+            LOG_ERROR("Cannot unhook import '{}'. Function name not found", function_name);
+            return false;
+        }
+
+        const auto info = read_dynamic_info(module_handle);
+        if(not info) {
+            return false;
+        }
+
+        auto success = true;
+        for(const auto& [slot, original_value] : it->second.slots) {
+            success &= write_slot(*info, slot, original_value);
+        }
+
+        const auto hook_id = it->second.hook_id;
+        import_hooks.erase(it);
+        release_trampoline(hook_id);
+
+        LOG_DEBUG("{} -> Unhooked import '{}' of module {}", __func__, function_name, module_handle);
+
+        return success;
+    }
+
+    size_t details::forget_import_hooks_in_range(const void* start_address, const void* end_address) {
+        const std::lock_guard lock(get_import_hook_mutex());
+
+        std::vector<hook_id_t> hook_ids;
+
+        // The slots are part of the unloaded module, so there is nothing to restore
+        const auto count = std::erase_if(
+            get_import_hook_map(),
+            [&](const auto& entry) {
+                const auto is_in_range = std::ranges::any_of(
+                    entry.second.slots,
+                    [&](const import_slot_t& slot) {
+                        return slot.address >= start_address && slot.address < end_address;
+                    }
+                );
+
+                if(is_in_range) {
+                    hook_ids.push_back(entry.second.hook_id);
+                }
+
+                return is_in_range;
+            }
+        );
+
+        for(const auto hook_id : hook_ids) {
+            release_trampoline(hook_id);
+        }
+
+        return count;
+    }
+
+    bool details::is_import_hooked(const std::string& function_name) {
+        const std::lock_guard lock(get_import_hook_mutex());
+
+        return std::ranges::any_of(
+            get_import_hook_map(),
+            [&](const auto& entry) {
+                return entry.first.second == function_name;
+            }
+        );
+    }
+}
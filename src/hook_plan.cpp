@@ -0,0 +1,113 @@
+#include <set>
+
+#include "koalabox/hook_plan.hpp"
+#include "koalabox/hook.hpp"
+#include "koalabox/lib.hpp"
+#include "koalabox/logger.hpp"
+
+namespace {
+    namespace kb = koalabox;
+    using namespace kb::hook_plan;
+
+    void resolve_symbol_hooks(
+        void* module_handle,
+        const std::vector<symbol_hook_t>& symbol_hooks,
+        std::vector<kb::hook::detour_entry_t>& entries
+    ) {
+        if(symbol_hooks.empty()) {
+            return;
+        }
+
+        std::set<std::string> function_names;
+        for(const auto& hook : symbol_hooks) {
+            function_names.insert(hook.function_name);
+        }
+
+        const auto addresses = kb::lib::get_function_addresses(module_handle, function_names);
+
+        for(const auto& [function_name, callback_function] : symbol_hooks) {
+            if(const auto it = addresses.find(function_name); it != addresses.end()) {
+                entries.push_back({it->second, function_name, callback_function});
+            } else {
+                LOG_WARN("Hook plan symbol '{}' was not found in module {}", function_name, module_handle);
+            }
+        }
+    }
+
+    void resolve_pattern_hooks(
+        void* module_handle,
+        const std::vector<pattern_hook_t>& pattern_hooks,
+        std::vector<kb::hook::detour_entry_t>& entries
+    ) {
+        if(pattern_hooks.empty()) {
+            return;
+        }
+
+        std::map<std::string, kb::patcher::pattern> pending_patterns;
+        for(const auto& hook : pattern_hooks) {
+            pending_patterns.emplace(hook.function_name, hook.pattern);
+        }
+
+        std::map<std::string, uintptr_t> addresses;
+        for(const auto& region : kb::lib::get_executable_regions(module_handle)) {
+            const auto found = kb::patcher::find_pattern_addresses(
+                reinterpret_cast<uintptr_t>(region.start_address),
+                region.size,
+                pending_patterns
+            );
+
+            // Regions are ordered by address, so the first match is the lowest one
+            for(const auto& [function_name, address] : found) {
+                addresses.emplace(function_name, address);
+                pending_patterns.erase(function_name);
+            }
+
+            if(pending_patterns.empty()) {
+                break;
+            }
+        }
+
+        for(const auto& [function_name, pattern, callback_function] : pattern_hooks) {
+            if(const auto it = addresses.find(function_name); it != addresses.end()) {
+                entries.push_back({reinterpret_cast<void*>(it->second), function_name, callback_function});
+            } else {
+                LOG_WARN("Hook plan pattern '{}' was not found in module {}", function_name, module_handle);
+            }
+        }
+    }
+}
+
+namespace koalabox::hook_plan {
+    size_t install(void* module_handle, const module_plan_t& module_plan) {
+        std::vector<hook::detour_entry_t> entries;
+        entries.reserve(module_plan.symbol_hooks.size() + module_plan.pattern_hooks.size());
+
+        resolve_symbol_hooks(module_handle, module_plan.symbol_hooks, entries);
+        resolve_pattern_hooks(module_handle, module_plan.pattern_hooks, entries);
+
+        if(entries.empty()) {
+            LOG_WARN("Hook plan of module {} has nothing to install", module_handle);
+            return 0;
+        }
+
+        hook::detour_batch_or_throw(entries);
+
+        LOG_INFO("Installed {} hooks from the hook plan of module {}", entries.size(), module_handle);
+
+        return entries.size();
+    }
+
+    lib_monitor::callbacks_t to_callbacks(const plan_t& plan) {
+        lib_monitor::callbacks_t callbacks;
+
+        for(const auto& [lib_name, module_plan] : plan) {
+            callbacks[lib_name] = [module_plan](void* module_handle) {
+                install(module_handle, module_plan);
+
+                return true; // Modules are hooked only once
+            };
+        }
+
+        return callbacks;
+    }
+}
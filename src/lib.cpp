@@ -1,11 +1,110 @@
+#include <mutex>
+
 #include "koalabox/lib.hpp"
 #include "koalabox/core.hpp"
 #include "koalabox/logger.hpp"
 #include "koalabox/path.hpp"
 
+namespace {
+    namespace lib = koalabox::lib;
+
+    std::mutex& get_symbol_index_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    // Key is module handle
+    std::map<void*, std::shared_ptr<const lib::symbol_index_t>>& get_symbol_index_cache() {
+        static std::map<void*, std::shared_ptr<const lib::symbol_index_t>> cache;
+        return cache;
+    }
+}
+
 namespace koalabox::lib {
     namespace fs = std::filesystem;
 
+    std::optional<void*> symbol_index_t::find(const std::string_view name) const {
+        if(const auto it = addresses.find(name); it != addresses.end()) {
+            return it->second;
+        }
+
+        return std::nullopt;
+    }
+
+    std::shared_ptr<const symbol_index_t> get_symbol_index(void* const lib_handle) {
+        {
+            const std::lock_guard lock(get_symbol_index_mutex());
+            if(const auto it = get_symbol_index_cache().find(lib_handle); it != get_symbol_index_cache().end()) {
+                return it->second;
+            }
+        }
+
+        // Built outside the lock, so that unrelated modules are not blocked by a large export table
+        std::shared_ptr<const symbol_index_t> index = details::read_symbol_index(lib_handle);
+        if(!index) {
+            // An empty index is cached as well, so that such modules go straight to the loader next time.
+            // It still needs the base address, by which it is invalidated once the module is unloaded.
+            const auto base_address = get_base_address(lib_handle);
+            index = std::make_shared<const symbol_index_t>(
+                symbol_index_t{.base_address = base_address.value_or(nullptr)}
+            );
+
+            if(!base_address) {
+                return index; // Handle may be reused by another module, hence it is not cached
+            }
+        }
+
+        LOG_TRACE("{} -> Indexed {} symbols of module {}", __func__, index->addresses.size(), lib_handle);
+
+        const std::lock_guard lock(get_symbol_index_mutex());
+        return get_symbol_index_cache().try_emplace(lib_handle, std::move(index)).first->second;
+    }
+
+    void invalidate_caches(const void* start_address, const void* end_address) {
+        {
+            const std::lock_guard lock(get_symbol_index_mutex());
+
+            std::erase_if(
+                get_symbol_index_cache(),
+                [&](const auto& entry) {
+                    const auto* const base_address = entry.second->base_address;
+                    return base_address >= start_address && base_address < end_address;
+                }
+            );
+        }
+
+#if defined(KB_LINUX)
+        details::invalidate_section_cache(start_address, end_address);
+#endif
+    }
+
+    std::optional<void*> find_function_address(void* const lib_handle, const std::string& function_name) {
+        if(const auto address = get_symbol_index(lib_handle)->find(function_name)) {
+            return address;
+        }
+
+        return get_function_address(lib_handle, function_name.c_str());
+    }
+
+    std::map<std::string, void*> get_function_addresses(
+        void* const lib_handle,
+        const std::set<std::string>& function_names
+    ) {
+        std::map<std::string, void*> result;
+
+        const auto index = get_symbol_index(lib_handle);
+
+        for(const auto& function_name : function_names) {
+            if(const auto address = index->find(function_name)) {
+                result.emplace_hint(result.end(), function_name, *address);
+            } else if(const auto fallback_address = get_function_address(lib_handle, function_name.c_str())) {
+                result.emplace_hint(result.end(), function_name, *fallback_address);
+            }
+        }
+
+        return result;
+    }
+
     void* get_function_address_or_throw(
         void* lib_handle,
         const char* function_name
@@ -1,17 +1,21 @@
+#include <algorithm>
 #include <cstring>
+#include <functional>
 #include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
 #include <vector>
 
-// ELFIO must be included before linux headers to avoid name collisions
-#include <elfio/elfio.hpp>
-
 #include <dlfcn.h>
 #include <link.h>
 #include <unistd.h>
 #include <linux/limits.h>
 
 #include "koalabox/core.hpp"
+#include "koalabox/elf.hpp"
 #include "koalabox/lib.hpp"
 #include "koalabox/logger.hpp"
 #include "koalabox/path.hpp"
@@ -19,6 +23,63 @@
 namespace {
     using namespace koalabox::lib;
 
+    struct section_header_t {
+        std::string name;
+        ElfW(Addr) address; // Relative to the module base
+        size_t size;
+    };
+
+    using section_table_t = std::vector<section_header_t>;
+
+    std::shared_ptr<const section_table_t> read_section_table(const std::string& elf_path) {
+        const auto elf_file = koalabox::elf::file::open(elf_path);
+        if(!elf_file) {
+            return nullptr;
+        }
+
+        auto table = std::make_shared<section_table_t>();
+        for(const auto& sec : elf_file->get_sections()) {
+            table->push_back({std::string(sec.name), static_cast<ElfW(Addr)>(sec.address), sec.size});
+        }
+
+        return table;
+    }
+
+    std::mutex& get_section_cache_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    /**
+     * Section tables are parsed from the file on disk, which is expensive for large binaries,
+     * hence each module's table is parsed only once. Key is the module base address.
+     */
+    std::map<ElfW(Addr), std::shared_ptr<const section_table_t>>& get_section_cache() {
+        static std::map<ElfW(Addr), std::shared_ptr<const section_table_t>> cache;
+        return cache;
+    }
+
+    std::shared_ptr<const section_table_t> get_section_table(
+        const std::string& elf_path,
+        ElfW(Addr) const lib_base
+    ) {
+        {
+            const std::lock_guard lock(get_section_cache_mutex());
+            if(const auto it = get_section_cache().find(lib_base); it != get_section_cache().end()) {
+                return it->second;
+            }
+        }
+
+        // Parse outside the lock, so that unrelated modules are not blocked by a slow file read
+        auto table = read_section_table(elf_path);
+        if(!table) {
+            return nullptr;
+        }
+
+        const std::lock_guard lock(get_section_cache_mutex());
+        return get_section_cache().try_emplace(lib_base, std::move(table)).first->second;
+    }
+
     std::vector<section_t> read_sections(
         const std::string& elf_path,
         const std::function<bool(const std::string&)>& name_matches,
@@ -26,25 +87,104 @@ namespace {
     ) {
         std::vector<section_t> sections;
 
-        ELFIO::elfio reader;
-        if(!reader.load(elf_path)) {
-            LOG_ERROR("Failed to load library in ELFIO: {}", elf_path);
+        const auto table = get_section_table(elf_path, lib_base);
+        if(!table) {
             return sections;
         }
 
-        for(const auto& sec : reader.sections) {
-            if(name_matches(sec->get_name())) {
-                const auto offset = sec->get_address();
-                const auto size = sec->get_size();
+        for(const auto& sec : *table) {
+            if(name_matches(sec.name)) {
                 auto* const base = reinterpret_cast<uint8_t*>(lib_base);
-                auto* start = base + offset;
-                auto* end = start + size;
-                sections.push_back(section_t{start, end, static_cast<uint32_t>(size)});
+                auto* start = base + sec.address;
+                auto* end = start + sec.size;
+                sections.push_back(section_t{start, end, static_cast<uint32_t>(sec.size)});
             }
         }
 
         return sections;
     }
+
+    /**
+     * Invokes the visitor with program headers of the module identified by the given handle.
+     * Relies solely on the in-memory program headers provided by the dynamic linker.
+     */
+    void for_each_module_phdr_info(
+        void* lib_handle,
+        const std::function<void(const dl_phdr_info& info, bool is_exe)>& visitor
+    ) {
+        link_map* lm;
+        if(dlinfo(lib_handle, RTLD_DI_LINKMAP, &lm) != 0) { // NOLINT(*-multi-level-implicit-pointer-conversion)
+            LOG_ERROR("Failed to get link_map from lib handle: {}", lib_handle);
+            return;
+        }
+
+        struct context_t {
+            const std::function<void(const dl_phdr_info&, bool)>& visitor;
+            const link_map* lm;
+        } context{visitor, lm};
+
+        dl_iterate_phdr(
+            [](dl_phdr_info* const info, size_t, void* data) {
+                const auto* ctx = static_cast<context_t*>(data);
+
+                if(info->dlpi_addr == ctx->lm->l_addr) {
+                    // Correct library found
+                    ctx->visitor(*info, false);
+                    return 1; // Stop iteration
+                }
+
+                if(info->dlpi_addr == reinterpret_cast<ElfW(Addr)>(ctx->lm)) {
+                    // Special case for exe handle
+                    ctx->visitor(*info, true);
+                    return 1;
+                }
+
+                return 0;
+            }, &context
+        );
+    }
+
+    // Versions of a symbol other than the default one are marked with this bit in the version table
+    constexpr ElfW(Versym) VERSYM_HIDDEN = 0x8000;
+
+    /**
+     * The dynamic section does not record the number of symbols, hence it is derived from the hash table.
+     * In GNU hash tables, the last symbol is at the end of the chain of the highest occupied bucket.
+     */
+    size_t get_symbol_count(const uint32_t* const sysv_hash, const uint32_t* const gnu_hash) {
+        if(sysv_hash) {
+            return sysv_hash[1]; // nchain
+        }
+
+        if(!gnu_hash) {
+            return 0;
+        }
+
+        const auto bucket_count = gnu_hash[0];
+        const auto symbol_offset = gnu_hash[1];
+        const auto bloom_size = gnu_hash[2];
+
+        const auto* const buckets = reinterpret_cast<const uint32_t*>(
+            reinterpret_cast<const ElfW(Addr)*>(gnu_hash + 4) + bloom_size
+        );
+        const auto* const chains = buckets + bucket_count;
+
+        uint32_t last_symbol = 0;
+        for(uint32_t i = 0; i < bucket_count; ++i) {
+            last_symbol = std::max(last_symbol, buckets[i]);
+        }
+
+        if(last_symbol < symbol_offset) {
+            return symbol_offset;
+        }
+
+        // The lowest bit marks the end of a chain
+        while(!(chains[last_symbol - symbol_offset] & 1)) {
+            ++last_symbol;
+        }
+
+        return last_symbol + 1;
+    }
 }
 
 namespace koalabox::lib {
@@ -91,41 +231,38 @@ namespace koalabox::lib {
     std::vector<section_t> get_sections(
         void* lib_handle, const std::function<bool(const std::string&)>& name_matches
     ) {
-        link_map* lm;
-        if(dlinfo(lib_handle, RTLD_DI_LINKMAP, &lm) != 0) { // NOLINT(*-multi-level-implicit-pointer-conversion)
-            LOG_ERROR("Failed to get link_map from lib handle: {}", lib_handle);
-            return {};
-        }
+        std::vector<section_t> result;
 
-        // Find the correct library
-        struct context_t {
-            const std::function<bool(const std::string&)>& name_matches;
-            const link_map* lm = nullptr;
-            std::vector<section_t> result;
-        } initial_context{name_matches, lm, {}};
+        for_each_module_phdr_info(
+            lib_handle, [&](const dl_phdr_info& info, const bool is_exe) {
+                const auto elf_path = is_exe ? path::to_str(get_fs_path(nullptr)) : std::string(info.dlpi_name);
+                result = read_sections(elf_path, name_matches, info.dlpi_addr);
+            }
+        );
 
-        dl_iterate_phdr(
-            [](dl_phdr_info* const info, size_t, void* data) {
-                auto* ctx = static_cast<context_t*>(data);
+        return result;
+    }
 
-                if(info->dlpi_addr == ctx->lm->l_addr) {
-                    // Correct library found
-                    ctx->result = read_sections(info->dlpi_name, ctx->name_matches, info->dlpi_addr);
-                    return 1; // Stop iteration
-                }
+    std::vector<section_t> get_executable_regions(void* lib_handle) {
+        std::vector<section_t> regions;
 
-                if(info->dlpi_addr == reinterpret_cast<ElfW(Addr)>(ctx->lm)) {
-                    // Special case for exe handle
-                    const auto exe_path = get_fs_path(nullptr);
-                    ctx->result = read_sections(path::to_str(exe_path), ctx->name_matches, info->dlpi_addr);
-                    return 1;
-                }
+        for_each_module_phdr_info(
+            lib_handle, [&](const dl_phdr_info& info, bool) {
+                for(int i = 0; i < info.dlpi_phnum; ++i) {
+                    const auto& phdr = info.dlpi_phdr[i];
+                    if(phdr.p_type != PT_LOAD || !(phdr.p_flags & PF_X)) {
+                        continue;
+                    }
 
-                return 0;
-            }, &initial_context
+                    auto* const start = reinterpret_cast<uint8_t*>(info.dlpi_addr + phdr.p_vaddr);
+                    regions.push_back(section_t{start, start + phdr.p_memsz, static_cast<uint32_t>(phdr.p_memsz)});
+                }
+            }
         );
 
-        return initial_context.result;
+        std::ranges::sort(regions, {}, &section_t::start_address);
+
+        return regions;
     }
 
     std::optional<section_t> get_section(void* lib_handle, const std::string& section_name) {
@@ -181,19 +318,39 @@ namespace koalabox::lib {
         return initial_context.result;
     }
 
+    std::vector<fs::path> get_loaded_module_paths() {
+        std::vector<fs::path> paths;
+
+        dl_iterate_phdr(
+            [](dl_phdr_info* const info, size_t, void* data) {
+                // The main executable and the vDSO have no path
+                if(info->dlpi_name && *info->dlpi_name) {
+                    static_cast<std::vector<fs::path>*>(data)->push_back(path::from_str(info->dlpi_name));
+                }
+
+                return 0;
+            }, &paths
+        );
+
+        return paths;
+    }
+
+    void* get_loaded_lib_handle(const fs::path& lib_path) {
+        return dlopen(path::to_str(lib_path).c_str(), RTLD_NOW | RTLD_NOLOAD);
+    }
+
     std::optional<Bitness> get_bitness(const fs::path& library_path) {
-        ELFIO::elfio reader;
-        const auto lib_path_str = path::to_str(library_path);
-        if(!reader.load(lib_path_str)) {
-            LOG_ERROR("Failed to load ELF file: {}", lib_path_str);
+        // Only the identification bytes are needed, so there is no point in loading the whole file
+        const auto elf_class = koalabox::elf::read_class(library_path);
+        if(!elf_class) {
             return std::nullopt;
         }
 
-        switch(reader.get_class()) {
+        switch(*elf_class) {
         case ELFCLASS32: return Bitness::$32;
         case ELFCLASS64: return Bitness::$64;
         default:
-            LOG_ERROR("Unknown ELF class: {}", reader.get_class());
+            LOG_ERROR("Unknown ELF class: {}", *elf_class);
             return std::nullopt;
         }
     }
@@ -221,4 +378,113 @@ namespace koalabox::lib {
 
         return reinterpret_cast<void*>(start_addr);
     }
+
+    void details::invalidate_section_cache(const void* start_address, const void* end_address) {
+        const std::lock_guard lock(get_section_cache_mutex());
+
+        std::erase_if(
+            get_section_cache(),
+            [&](const auto& entry) {
+                const auto* const base_address = reinterpret_cast<const void*>(entry.first);
+                return base_address >= start_address && base_address < end_address;
+            }
+        );
+    }
+
+    std::shared_ptr<symbol_index_t> details::read_symbol_index(void* const lib_handle) {
+        std::shared_ptr<symbol_index_t> index;
+
+        for_each_module_phdr_info(
+            lib_handle, [&](const dl_phdr_info& info, bool) {
+                const ElfW(Dyn)* dynamic = nullptr;
+                for(int i = 0; i < info.dlpi_phnum; ++i) {
+                    if(info.dlpi_phdr[i].p_type == PT_DYNAMIC) {
+                        dynamic = reinterpret_cast<const ElfW(Dyn)*>(info.dlpi_addr + info.dlpi_phdr[i].p_vaddr);
+                    }
+                }
+
+                if(!dynamic) {
+                    LOG_ERROR("Module {} has no dynamic section", lib_handle);
+                    return;
+                }
+
+                // glibc relocates the dynamic section entries in place, other loaders may not
+                const auto to_address = [&](const ElfW(Addr) value) {
+                    return value < info.dlpi_addr ? info.dlpi_addr + value : value;
+                };
+
+                const ElfW(Sym)* symbols = nullptr;
+                const char* strings = nullptr;
+                size_t strings_size = 0;
+                const ElfW(Versym)* versions = nullptr;
+                const uint32_t* sysv_hash = nullptr;
+                const uint32_t* gnu_hash = nullptr;
+
+                for(const auto* dyn = dynamic; dyn->d_tag != DT_NULL; ++dyn) {
+                    switch(dyn->d_tag) {
+                    case DT_SYMTAB: symbols = reinterpret_cast<const ElfW(Sym)*>(to_address(dyn->d_un.d_ptr));
+                        break;
+                    case DT_STRTAB: strings = reinterpret_cast<const char*>(to_address(dyn->d_un.d_ptr));
+                        break;
+                    case DT_STRSZ: strings_size = dyn->d_un.d_val;
+                        break;
+                    case DT_VERSYM: versions = reinterpret_cast<const ElfW(Versym)*>(to_address(dyn->d_un.d_ptr));
+                        break;
+                    case DT_HASH: sysv_hash = reinterpret_cast<const uint32_t*>(to_address(dyn->d_un.d_ptr));
+                        break;
+                    case DT_GNU_HASH: gnu_hash = reinterpret_cast<const uint32_t*>(to_address(dyn->d_un.d_ptr));
+                        break;
+                    default: break;
+                    }
+                }
+
+                if(!symbols || !strings) {
+                    LOG_ERROR("Module {} has no dynamic symbol table", lib_handle);
+                    return;
+                }
+
+                const auto symbol_count = get_symbol_count(sysv_hash, gnu_hash);
+
+                index = std::make_shared<symbol_index_t>();
+                index->base_address = reinterpret_cast<const void*>(info.dlpi_addr);
+                index->addresses.reserve(symbol_count);
+
+                // Left to the loader: names defined more than once, and STT_GNU_IFUNC symbols,
+                // whose address is picked by a resolver at runtime.
+                std::set<std::string_view> ambiguous_names;
+
+                for(size_t i = 1; i < symbol_count; ++i) {
+                    const auto& symbol = symbols[i];
+
+                    const auto bind = symbol.st_info >> 4;
+                    if(symbol.st_shndx == SHN_UNDEF || (bind != STB_GLOBAL && bind != STB_WEAK)) {
+                        continue;
+                    }
+
+                    // Only the default version of a symbol is visible to the loader lookups
+                    if(versions && versions[i] & VERSYM_HIDDEN) {
+                        continue;
+                    }
+
+                    if(symbol.st_name >= strings_size) {
+                        continue;
+                    }
+
+                    const auto name = std::string_view(strings + symbol.st_name);
+                    auto* const address = reinterpret_cast<void*>(info.dlpi_addr + symbol.st_value);
+
+                    const auto [it, inserted] = index->addresses.emplace(name, address);
+                    if(not inserted || (symbol.st_info & 0xF) != STT_FUNC) {
+                        ambiguous_names.insert(name);
+                    }
+                }
+
+                for(const auto& name : ambiguous_names) {
+                    index->addresses.erase(name);
+                }
+            }
+        );
+
+        return index;
+    }
 }
@@ -1,70 +1,276 @@
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <ranges>
 #include <set>
+#include <stop_token>
+#include <thread>
+#include <vector>
 
 #include "koalabox/lib_monitor.hpp"
+#include "koalabox/hook.hpp"
 #include "koalabox/lib.hpp"
 #include "koalabox/logger.hpp"
 #include "koalabox/path.hpp"
+#include "koalabox/re.hpp"
+#include "koalabox/str.hpp"
 
 namespace {
     using namespace koalabox::lib_monitor;
 
+    /**
+     * Guards the callbacks, which are looked up by loading threads while the dispatcher may be removing them.
+     * It is never held while a callback runs, since callbacks are free to load libraries themselves.
+     */
+    std::mutex& get_callbacks_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    /**
+     * Callbacks that are currently running, along with the thread that runs them. Invocations of the same callback
+     * are serialized through it, while invocations of different callbacks may run at the same time.
+     * Guarded by the callbacks mutex.
+     */
+    std::map<dll_name_t, std::thread::id, koalabox::str::case_insensitive_compare>& get_running_callbacks() {
+        static std::map<dll_name_t, std::thread::id, koalabox::str::case_insensitive_compare> running_callbacks;
+        return running_callbacks;
+    }
+
+    // Notified whenever a callback has finished running
+    std::condition_variable& get_callbacks_condition() {
+        static std::condition_variable condition;
+        return condition;
+    }
+
+    bool has_callback(const dll_name_t& callback_name) {
+        const std::lock_guard lock(get_callbacks_mutex());
+
+        return details::get_callbacks().contains(callback_name);
+    }
+
     void process_library(const std::string& lib_name, void* lib_handle) {
-        static std::mutex section;
-        const std::lock_guard lock(section);
+        auto& running_callbacks = get_running_callbacks();
 
-        auto& callbacks = details::get_callbacks();
+        callback_t callback;
+        {
+            std::unique_lock lock(get_callbacks_mutex());
+
+            // The callback itself has loaded another library of the same name, which must not wait for itself
+            if(const auto it = running_callbacks.find(lib_name);
+                it != running_callbacks.end() && it->second == std::this_thread::get_id()) {
+                LOG_WARN("Skipping nested callback invocation for library '{}'", lib_name);
+                return;
+            }
+
+            get_callbacks_condition().wait(lock, [&] { return !running_callbacks.contains(lib_name); });
+
+            const auto& callbacks = details::get_callbacks();
+            const auto it = callbacks.find(lib_name);
+            if(it == callbacks.end()) {
+                return; // Removed after the library was dispatched
+            }
+
+            callback = it->second;
+            running_callbacks.emplace(lib_name, std::this_thread::get_id());
+        }
 
         bool should_remove_callback;
         try {
-            const auto& callback = callbacks.at(lib_name);
             should_remove_callback = callback(lib_handle);
         } catch(const std::exception& e) {
             LOG_ERROR("{} -> Exception raised during callback invocation: {}", lib_name, e.what());
             should_remove_callback = true;
         }
 
-        if(!should_remove_callback) {
-            return;
-        }
+        bool has_no_callbacks = false;
+        {
+            const std::lock_guard lock(get_callbacks_mutex());
 
-        callbacks.erase(lib_name);
+            running_callbacks.erase(lib_name);
 
-        if(callbacks.empty()) {
+            if(should_remove_callback) {
+                auto& callbacks = details::get_callbacks();
+                // Only the invocation that actually removes the last callback shuts the monitor down
+                has_no_callbacks = callbacks.erase(lib_name) && callbacks.empty();
+            }
+        }
+        get_callbacks_condition().notify_all();
+
+        if(has_no_callbacks) {
             // we have to start a new thread for cases where we shut down right after initialization
             std::thread(shutdown_listener).detach();
         }
     }
 
-    void check_loaded_modules() {
-        // The map might change during iteration, so we need to iterate over a copy of keys
-        auto keys = std::views::keys(details::get_callbacks());
-        const std::set lib_names(keys.begin(), keys.end());
+    options_t& get_options() {
+        static options_t options;
+        return options;
+    }
+
+    /**
+     * Libraries waiting for their callbacks in async mode. A single worker drains the queue,
+     * which preserves the load order, and with it the order of the loads of each library.
+     */
+    struct dispatch_queue_t {
+        std::mutex mutex;
+        std::condition_variable_any condition;
+        std::deque<std::pair<std::string, void*>> items; // (lib name, lib handle)
+        std::optional<std::jthread> worker;
+    };
+
+    dispatch_queue_t& get_dispatch_queue() {
+        static dispatch_queue_t queue;
+        return queue;
+    }
 
-        for(const auto& lib_name : lib_names) {
-            auto* const module_handle = koalabox::lib::get_lib_handle(lib_name);
+    void dispatch_callbacks(const std::stop_token& stop_token) {
+        auto& queue = get_dispatch_queue();
 
-            if(not module_handle) {
-                continue;
+        while(true) {
+            std::pair<std::string, void*> item;
+            {
+                std::unique_lock lock(queue.mutex);
+                if(!queue.condition.wait(lock, stop_token, [&] { return !queue.items.empty(); })) {
+                    return; // Stop requested
+                }
+
+                item = std::move(queue.items.front());
+                queue.items.pop_front();
+            }
+
+            process_library(item.first, item.second);
+        }
+    }
+
+    void start_dispatcher() {
+        auto& queue = get_dispatch_queue();
+        queue.items.clear();
+        queue.worker.emplace(dispatch_callbacks);
+    }
+
+    void stop_dispatcher() {
+        auto& queue = get_dispatch_queue();
+        if(!queue.worker) {
+            return;
+        }
+
+        // The worker may be the one that shuts the monitor down, in which case it must not join itself
+        if(queue.worker->get_id() == std::this_thread::get_id()) {
+            queue.worker->request_stop();
+            queue.worker->detach();
+        }
+        queue.worker.reset();
+
+        const std::lock_guard lock(queue.mutex);
+        queue.items.clear();
+    }
+
+    void enqueue_library(const std::string& lib_name, void* lib_handle) {
+        auto& queue = get_dispatch_queue();
+        {
+            const std::lock_guard lock(queue.mutex);
+            queue.items.emplace_back(lib_name, lib_handle);
+        }
+        queue.condition.notify_one();
+    }
+
+    details::lib_name_matcher& get_matcher() {
+        static details::lib_name_matcher matcher;
+        return matcher;
+    }
+
+    /** Both arguments are expected to be lowercase. */
+    bool matches_glob(const std::string_view pattern, const std::string_view text) {
+        size_t p = 0, t = 0;
+
+        // Position of the last star and of the text it was matched against, for backtracking
+        auto star = std::string_view::npos;
+        size_t star_t = 0;
+
+        while(t < text.size()) {
+            if(p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+                ++p;
+                ++t;
+            } else if(p < pattern.size() && pattern[p] == '*') {
+                star = p++;
+                star_t = t;
+            } else if(star != std::string_view::npos) {
+                // Let the last star consume one more character
+                p = star + 1;
+                t = ++star_t;
+            } else {
+                return false;
             }
+        }
+
+        while(p < pattern.size() && pattern[p] == '*') {
+            ++p;
+        }
+
+        return p == pattern.size();
+    }
+
+    void dispatch_library(const std::string& lib_name, void* lib_handle) {
+        if(const auto& options = get_options();
+            options.async_callbacks && !options.blocking_callbacks.contains(lib_name)) {
+            enqueue_library(lib_name, lib_handle);
+            return;
+        }
+
+        process_library(lib_name, lib_handle);
+    }
+
+    void check_loaded_modules() {
+        // Each callback is invoked only for the first matching module
+        std::set<std::string> processed_names;
+
+        for(const auto& module_path : koalabox::lib::get_loaded_module_paths()) {
+            // The callbacks might change during iteration, hence the check for every name
+            for(const auto& lib_name : get_matcher().match(details::get_lib_name(module_path))) {
+                if(not processed_names.insert(lib_name).second || not has_callback(lib_name)) {
+                    continue;
+                }
 
-            LOG_INFO("Library is already loaded: '{}'", lib_name);
+                auto* const module_handle = koalabox::lib::get_loaded_lib_handle(module_path);
+                if(not module_handle) {
+                    continue; // Unloaded in the meantime
+                }
 
-            process_library(lib_name, module_handle);
+                LOG_INFO("Library is already loaded: '{}'", lib_name);
+
+                process_library(lib_name, module_handle);
+            }
         }
     }
 }
 
 namespace koalabox::lib_monitor {
-    void init_listener(const callbacks_t& callbacks) {
+    void init_listener(const callbacks_t& callbacks, const options_t& options) {
         if(is_initialized()) {
             LOG_WARN("Library monitor is already initialized.");
             return;
         }
         LOG_DEBUG("Initializing library monitor...");
 
-        details::get_callbacks() = callbacks;
-        details::init();
+        {
+            const std::lock_guard lock(get_callbacks_mutex());
+            details::get_callbacks() = callbacks;
+        }
+        get_options() = options;
+        if(options.backend == backend_t::link_map_polling && !options.blocking_callbacks.empty()) {
+            LOG_WARN("Blocking callbacks cannot run before the load returns with the link map polling backend");
+        }
+        get_matcher() = details::lib_name_matcher(callbacks, options.match_rules);
+
+        if(options.async_callbacks) {
+            start_dispatcher();
+        }
+
+        details::init(options);
 
         LOG_DEBUG("Library monitor initialized");
 
@@ -80,6 +286,9 @@ namespace koalabox::lib_monitor {
         LOG_DEBUG("Shutting down library monitor...");
 
         details::shutdown();
+        stop_dispatcher();
+
+        const std::lock_guard lock(get_callbacks_mutex());
         details::get_callbacks().clear();
 
         LOG_DEBUG("Library monitor shut down");
@@ -97,7 +306,7 @@ namespace koalabox::lib_monitor {
             }
 
             const auto lib_path = str::to_str(filename);
-            const auto lib_name = path::to_str(std::filesystem::path(lib_path).stem());
+            const auto lib_name = get_lib_name(lib_path);
 
 #ifdef KB_DEBUG
             LOG_TRACE("DLL loaded: '{}' -> '{}'", lib_name, lib_path);
@@ -105,13 +314,116 @@ namespace koalabox::lib_monitor {
             LOG_DEBUG("DLL loaded: '{}'", lib_name);
 #endif
 
-            if(!get_callbacks().contains(lib_name)) {
+            for(const auto& callback_name : get_matcher().match(lib_name)) {
+                if(!has_callback(callback_name)) {
+                    continue;
+                }
+
+                LOG_INFO("Target library '{}' has been loaded: {}", callback_name, lib_handle);
+
+                dispatch_library(callback_name, lib_handle);
+            }
+        }
+
+        bool has_matching_callback(const TCHAR* filename) {
+            if(!filename) {
+                return false;
+            }
+
+            return std::ranges::any_of(get_matcher().match(get_lib_name(str::to_str(filename))), has_callback);
+        }
+
+        void on_library_unloaded(const TCHAR* filename, const void* start_address, const void* end_address) {
+            if(!filename) {
                 return;
             }
 
-            LOG_INFO("Target library '{}' has been loaded: {}", lib_name, lib_handle);
+            const auto lib_name = get_lib_name(str::to_str(filename));
+
+            LOG_DEBUG("DLL unloaded: '{}' [{}, {})", lib_name, start_address, end_address);
 
-            process_library(lib_name, lib_handle);
+            if(const auto hook_count = hook::forget_hooks_in_range(start_address, end_address)) {
+                LOG_INFO("Forgot {} hooks of unloaded library '{}'", hook_count, lib_name);
+            }
+
+            lib::invalidate_caches(start_address, end_address);
+            re::invalidate_cache(
+                reinterpret_cast<uintptr_t>(start_address),
+                reinterpret_cast<uintptr_t>(end_address)
+            );
+
+            if(const auto& unload_callback = get_options().unload_callback) {
+                try {
+                    unload_callback(lib_name);
+                } catch(const std::exception& e) {
+                    LOG_ERROR("{} -> Exception raised during unload callback invocation: {}", lib_name, e.what());
+                }
+            }
+        }
+
+        lib_name_matcher::lib_name_matcher(const callbacks_t& callbacks, const match_rules_t& match_rules) {
+            for(const auto& callback_name : std::views::keys(callbacks)) {
+                const auto it = match_rules.find(callback_name);
+                const auto match = it == match_rules.end() ? match_t::exact : it->second;
+
+                auto pattern = str::to_lower(callback_name);
+
+                if(match == match_t::exact) {
+                    exact_names.emplace(std::move(pattern), callback_name);
+                    continue;
+                }
+
+                // Glob patterns are indexed by their literal beginning, so that only plausible ones are evaluated
+                const auto literal_prefix = match == match_t::glob
+                                                ? pattern.substr(0, pattern.find_first_of("*?"))
+                                                : pattern;
+
+                prefix_lengths.insert(literal_prefix.size());
+                prefix_rules[literal_prefix].push_back({callback_name, match, std::move(pattern)});
+            }
+        }
+
+        std::vector<dll_name_t> lib_name_matcher::match(const dll_name_t& lib_name) const {
+            std::vector<dll_name_t> callback_names;
+
+            const auto lowercase_name = str::to_lower(lib_name);
+
+            if(const auto it = exact_names.find(lowercase_name); it != exact_names.end()) {
+                callback_names.push_back(it->second);
+            }
+
+            for(const auto length : prefix_lengths) {
+                if(length > lowercase_name.size()) {
+                    break;
+                }
+
+                const auto it = prefix_rules.find(lowercase_name.substr(0, length));
+                if(it == prefix_rules.end()) {
+                    continue;
+                }
+
+                for(const auto& rule : it->second) {
+                    if(rule.match == match_t::prefix || matches_glob(rule.pattern, lowercase_name)) {
+                        callback_names.push_back(rule.callback_name);
+                    }
+                }
+            }
+
+            return callback_names;
+        }
+
+        dll_name_t get_lib_name(const std::filesystem::path& lib_path) {
+#if defined(KB_LINUX)
+            // Versioned libraries are named like libfoo.so.1.2
+            const auto file_name = path::to_str(lib_path.filename());
+            for(auto pos = file_name.find(".so"); pos != std::string::npos; pos = file_name.find(".so", pos + 1)) {
+                if(pos + 3 == file_name.size() || file_name[pos + 3] == '.') {
+                    return file_name.substr(0, pos);
+                }
+            }
+#endif
+            return path::to_str(lib_path.stem());
         }
     }
 }
+
@@ -1,7 +1,17 @@
+#include <algorithm>
+#include <condition_variable>
+#include <iterator>
+#include <mutex>
+#include <optional>
 #include <ranges>
 #include <set>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <dlfcn.h>
+#include <link.h>
 
 #include "koalabox/hook.hpp"
 #include "koalabox/lib_monitor.hpp"
@@ -14,11 +24,143 @@ namespace {
     namespace kb = koalabox;
     using namespace kb::lib_monitor;
 
+    struct link_map_object_t {
+        ElfW(Addr) base;
+        std::string path;
+        // Span of the loaded segments
+        uintptr_t start_address;
+        uintptr_t end_address;
+
+        auto operator<=>(const link_map_object_t&) const = default;
+    };
+
+    /**
+     * Keeps track of the objects in the link map, so that every newly loaded object is reported exactly once,
+     * including the DT_NEEDED dependencies that the loader brings in on its own, and so is every unloaded object.
+     */
+    struct link_map_state_t {
+        std::mutex mutex;
+        // Values of dlpi_adds and dlpi_subs at the time of the last scan
+        unsigned long long adds = 0;
+        unsigned long long subs = 0;
+        std::set<link_map_object_t> objects;
+    };
+
+    link_map_state_t& get_link_map_state() {
+        static link_map_state_t state;
+        return state;
+    }
+
+    struct link_map_changes_t {
+        std::vector<link_map_object_t> loaded;
+        std::vector<link_map_object_t> unloaded;
+    };
+
+    /**
+     * @return Objects that were loaded or unloaded since the previous scan.
+     * If nothing has changed, this costs a single iteration of dl_iterate_phdr.
+     */
+    link_map_changes_t scan_link_map() {
+        auto& state = get_link_map_state();
+        const std::lock_guard lock(state.mutex);
+
+        struct context_t {
+            link_map_state_t& state;
+            std::set<link_map_object_t> objects;
+            bool is_first = true;
+            bool is_unchanged = false;
+        } context{state, {}};
+
+        dl_iterate_phdr(
+            [](dl_phdr_info* const info, const size_t size, void* data) {
+                auto* const ctx = static_cast<context_t*>(data);
+
+                // The counters are the same for all objects, so the first one tells whether anything has changed
+                if(std::exchange(ctx->is_first, false) && size >= sizeof(dl_phdr_info)) {
+                    if(info->dlpi_adds == ctx->state.adds && info->dlpi_subs == ctx->state.subs) {
+                        ctx->is_unchanged = true;
+                        return 1;
+                    }
+
+                    ctx->state.adds = info->dlpi_adds;
+                    ctx->state.subs = info->dlpi_subs;
+                }
+
+                // The main executable and the vDSO have no path
+                if(!info->dlpi_name || !*info->dlpi_name) {
+                    return 0;
+                }
+
+                auto start_address = UINTPTR_MAX;
+                uintptr_t end_address = 0;
+                for(int i = 0; i < info->dlpi_phnum; ++i) {
+                    if(const auto& phdr = info->dlpi_phdr[i]; phdr.p_type == PT_LOAD) {
+                        start_address = std::min<uintptr_t>(start_address, info->dlpi_addr + phdr.p_vaddr);
+                        end_address = std::max<uintptr_t>(end_address, info->dlpi_addr + phdr.p_vaddr + phdr.p_memsz);
+                    }
+                }
+
+                ctx->objects.insert({info->dlpi_addr, info->dlpi_name, start_address, end_address});
+
+                return 0;
+            }, &context
+        );
+
+        if(context.is_unchanged) {
+            return {};
+        }
+
+        link_map_changes_t changes;
+        std::ranges::set_difference(context.objects, state.objects, std::back_inserter(changes.loaded));
+        std::ranges::set_difference(state.objects, context.objects, std::back_inserter(changes.unloaded));
+
+        state.objects = std::move(context.objects);
+
+        return changes;
+    }
+
+    /**
+     * Notifies the monitor about every object loaded or unloaded since the previous scan.
+     * Must not be called while the loader lock is held, since callbacks are free to use the loader.
+     */
+    void report_link_map_changes() {
+        const auto [loaded, unloaded] = scan_link_map();
+
+        // Unloads go first, since a new object may have taken the place of an unloaded one
+        for(const auto& object : unloaded) {
+            details::on_library_unloaded(
+                object.path.c_str(),
+                reinterpret_cast<const void*>(object.start_address),
+                reinterpret_cast<const void*>(object.end_address)
+            );
+        }
+
+        for(const auto& object : loaded) {
+            // Opening the object goes through the dlopen detour again, hence only targets are opened
+            if(!details::has_matching_callback(object.path.c_str())) {
+                LOG_TRACE("DLL loaded: '{}'", object.path);
+                continue;
+            }
+
+            // RTLD_NOLOAD only looks up the object, but it still increments the reference count
+            auto* const lib_handle = dlopen(object.path.c_str(), RTLD_NOW | RTLD_NOLOAD);
+            if(!lib_handle) {
+                continue; // Already unloaded
+            }
+
+            details::on_library_loaded(object.path.c_str(), lib_handle);
+
+            dlclose(lib_handle);
+        }
+    }
+
     void* $dlopen(const char* filename, const int flag) {
         static const auto dlopen$ = KB_HOOK_GET_HOOKED_FN(dlopen);
         auto* const lib_handle = dlopen$(filename, flag);
 
-        details::on_library_loaded(filename, lib_handle);
+        if(lib_handle) {
+            report_link_map_changes();
+        }
 
         return lib_handle;
     }
@@ -27,26 +169,86 @@ namespace {
         static const auto dlmopen$ = KB_HOOK_GET_HOOKED_FN(dlmopen);
         auto* const lib_handle = dlmopen$(namespace_id, filename, flag);
 
+        if(namespace_id == LM_ID_BASE) {
+            // Same as dlopen, hence reporting it directly would make the next scan report it again
+            if(lib_handle) {
+                report_link_map_changes();
+            }
+            return lib_handle;
+        }
+
+        // Objects in other namespaces are not visible to dl_iterate_phdr
         details::on_library_loaded(filename, lib_handle);
 
         return lib_handle;
     }
+
+    int $dlclose(void* lib_handle) {
+        static const auto dlclose$ = KB_HOOK_GET_HOOKED_FN(dlclose);
+        const auto result = dlclose$(lib_handle);
+
+        if(result == 0) {
+            report_link_map_changes();
+        }
+
+        return result;
+    }
+
+    std::optional<std::jthread>& get_poll_thread() {
+        static std::optional<std::jthread> poll_thread;
+        return poll_thread;
+    }
+
+    void poll_link_map(const std::stop_token& stop_token, const std::chrono::milliseconds poll_interval) {
+        std::mutex mutex;
+        std::condition_variable_any stop_condition;
+
+        LOG_DEBUG("Polling link map every {} ms", poll_interval.count());
+
+        while(!stop_token.stop_requested()) {
+            report_link_map_changes();
+
+            std::unique_lock lock(mutex);
+            stop_condition.wait_for(lock, stop_token, poll_interval, [] { return false; });
+        }
+    }
 }
 
 namespace koalabox::lib_monitor {
     bool is_initialized() {
-        return hook::is_hooked("dlopen") || hook::is_hooked("dlmopen");
+        return hook::is_hooked("dlopen") || hook::is_hooked("dlmopen") || hook::is_hooked("dlclose") ||
+               get_poll_thread().has_value();
     }
 
     namespace details {
-        void init() {
+        void init(const options_t& options) {
+            // Objects that are already loaded are handled separately, hence only the baseline is recorded here
+            scan_link_map();
+
+            if(options.backend == backend_t::link_map_polling) {
+                get_poll_thread().emplace(poll_link_map, options.poll_interval);
+                return;
+            }
+
             HOOK(dlopen);
             HOOK(dlmopen);
+            HOOK(dlclose);
         }
 
         void shutdown() {
+            if(auto& poll_thread = get_poll_thread()) {
+                // The thread may be the one that shuts the monitor down, in which case it must not join itself
+                if(poll_thread->get_id() == std::this_thread::get_id()) {
+                    poll_thread->request_stop();
+                    poll_thread->detach();
+                }
+                poll_thread.reset();
+                return;
+            }
+
             hook::unhook("dlopen");
             hook::unhook("dlmopen");
+            hook::unhook("dlclose");
         }
     }
 }
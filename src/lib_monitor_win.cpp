@@ -24,7 +24,18 @@ namespace {
         const PLDR_DLL_NOTIFICATION_DATA NotificationData,
         [[maybe_unused]] PVOID Context
     ) {
-        // We're interested only in load events
+        if(NotificationReason == LDR_DLL_NOTIFICATION_REASON_UNLOADED) {
+            const auto& unloaded = NotificationData->Unloaded;
+            auto* const start_address = static_cast<const uint8_t*>(unloaded.DllBase);
+
+            details::on_library_unloaded(
+                unloaded.FullDllName->Buffer,
+                start_address,
+                start_address + unloaded.SizeOfImage
+            );
+            return;
+        }
+
         if(NotificationReason != LDR_DLL_NOTIFICATION_REASON_LOADED) {
             return;
         }
@@ -50,7 +61,12 @@ namespace koalabox::lib_monitor {
     }
 
     namespace details {
-        void init() {
+        void init(const options_t& options) {
+            // Loader notifications already cover dependencies and involve no patching
+            if(options.backend != backend_t::loader_hook) {
+                LOG_WARN("Link map polling is not supported on Windows. Using loader notifications instead.");
+            }
+
             const auto status_code = CALL_NT_DLL(LdrRegisterDllNotification)(
                 0, // Flags
                 notification_listener,
@@ -27,6 +27,11 @@ namespace koalabox::lib {
         return {};
     }
 
+    std::optional<void*> get_base_address(void* const lib_handle) {
+        // Module handle is the base address of the module on Windows
+        return lib_handle;
+    }
+
     std::vector<section_t> get_sections(
         void* const lib_handle, const std::function<bool(const std::string&)>& name_matches
     ) {
@@ -66,6 +71,43 @@ namespace koalabox::lib {
         return sections;
     }
 
+    std::vector<section_t> get_executable_regions(void* const lib_handle) {
+        std::vector<section_t> regions;
+
+        const auto* const dos_header = static_cast<PIMAGE_DOS_HEADER>(lib_handle);
+        if(dos_header->e_magic != IMAGE_DOS_SIGNATURE) {
+            LOG_ERROR("Invalid DOS file: {}", kb::path::to_str(lib::get_fs_path(lib_handle)));
+            return regions;
+        }
+
+        const auto* const nt_header = reinterpret_cast<PIMAGE_NT_HEADERS>(
+            static_cast<uint8_t*>(lib_handle) + dos_header->e_lfanew
+        );
+        if(nt_header->Signature != IMAGE_NT_SIGNATURE) {
+            LOG_ERROR("Invalid NT signature: {}", kb::path::to_str(lib::get_fs_path(lib_handle)));
+            return regions;
+        }
+
+        // Unlike get_sections, this describes the mapped image, hence virtual addresses and sizes
+        const auto* section = IMAGE_FIRST_SECTION(nt_header);
+        for(int i = 0; i < nt_header->FileHeader.NumberOfSections; i++, section++) {
+            if(!(section->Characteristics & IMAGE_SCN_MEM_EXECUTE)) {
+                continue;
+            }
+
+            auto* const section_start = static_cast<uint8_t*>(lib_handle) + section->VirtualAddress;
+            regions.push_back(
+                section_t{
+                    .start_address = section_start,
+                    .end_address = section_start + section->Misc.VirtualSize,
+                    .size = section->Misc.VirtualSize,
+                }
+            );
+        }
+
+        return regions;
+    }
+
     std::optional<section_t> get_section(void* const lib_handle, const std::string& section_name) {
         const auto sections = get_sections(
             lib_handle, [&](const std::string& name) { return name == section_name; }
@@ -92,6 +134,39 @@ namespace koalabox::lib {
         return GetModuleHandleW(str::to_wstr(lib_name).c_str());
     }
 
+    std::vector<std::filesystem::path> get_loaded_module_paths() {
+        std::vector<std::filesystem::path> paths;
+
+        std::vector<HMODULE> modules(256);
+        DWORD size_needed = 0;
+        while(true) {
+            const auto size = static_cast<DWORD>(modules.size() * sizeof(HMODULE));
+            if(!EnumProcessModules(GetCurrentProcess(), modules.data(), size, &size_needed)) {
+                LOG_ERROR("Failed to enumerate process modules. Last error: {}", GetLastError());
+                return paths;
+            }
+
+            if(size_needed <= size) {
+                break;
+            }
+
+            // Other threads may load modules in the meantime, hence some headroom
+            modules.resize(size_needed / sizeof(HMODULE) + 16);
+        }
+
+        const auto count = size_needed / sizeof(HMODULE);
+        paths.reserve(count);
+        for(DWORD i = 0; i < count; i++) {
+            paths.push_back(get_fs_path(modules[i]));
+        }
+
+        return paths;
+    }
+
+    void* get_loaded_lib_handle(const std::filesystem::path& lib_path) {
+        return GetModuleHandleW(lib_path.c_str());
+    }
+
     std::optional<Bitness> get_bitness(const std::filesystem::path& library_path) {
         std::ifstream file(library_path, std::ios::binary);
         if(!file.is_open()) {
@@ -136,4 +211,43 @@ namespace koalabox::lib {
     void* get_exe_handle() {
         return GetModuleHandle(nullptr);
     }
+
+    std::shared_ptr<symbol_index_t> details::read_symbol_index(void* const lib_handle) {
+        auto* const base = static_cast<uint8_t*>(lib_handle);
+
+        const auto* const dos_header = reinterpret_cast<PIMAGE_DOS_HEADER>(base);
+        const auto* const nt_header = reinterpret_cast<PIMAGE_NT_HEADERS>(base + dos_header->e_lfanew);
+
+        if(dos_header->e_magic != IMAGE_DOS_SIGNATURE || nt_header->Signature != IMAGE_NT_SIGNATURE) {
+            LOG_ERROR("Invalid PE headers of module: {}", lib_handle);
+            return nullptr;
+        }
+
+        auto index = std::make_shared<symbol_index_t>();
+        index->base_address = lib_handle;
+
+        const auto& export_entry = nt_header->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+        if(!export_entry.VirtualAddress || !export_entry.Size) {
+            return index;
+        }
+
+        const auto* const export_dir = reinterpret_cast<PIMAGE_EXPORT_DIRECTORY>(base + export_entry.VirtualAddress);
+        const auto* const names = reinterpret_cast<const DWORD*>(base + export_dir->AddressOfNames);
+        const auto* const ordinals = reinterpret_cast<const WORD*>(base + export_dir->AddressOfNameOrdinals);
+        const auto* const functions = reinterpret_cast<const DWORD*>(base + export_dir->AddressOfFunctions);
+
+        index->addresses.reserve(export_dir->NumberOfNames);
+
+        for(DWORD i = 0; i < export_dir->NumberOfNames; i++) {
+            // Forwarded exports point to a string within the export directory and are left to GetProcAddress
+            const auto rva = functions[ordinals[i]];
+            if(rva >= export_entry.VirtualAddress && rva < export_entry.VirtualAddress + export_entry.Size) {
+                continue;
+            }
+
+            index->addresses.emplace(reinterpret_cast<const char*>(base + names[i]), base + rva);
+        }
+
+        return index;
+    }
 }
@@ -1,80 +1,927 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <chrono>
+#include <condition_variable>
 #include <cstring>
-#include <regex>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define KB_PATCHER_SIMD
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
 
 #include "koalabox/patcher.hpp"
+#include "koalabox/cache.hpp"
+#include "koalabox/lib.hpp"
 #include "koalabox/logger.hpp"
+#include "koalabox/path.hpp"
+
+// MSVC compiles intrinsics for any instruction set without per-function opt-in,
+// whereas GCC and Clang require the target ISA to be enabled on the function itself.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define KB_TARGET(ISA)
+#else
+#define KB_TARGET(ISA) __attribute__((target(ISA)))
+#endif
 
 namespace {
-    struct pattern_mask {
-        std::string binary_pattern;
-        std::string mask;
+    namespace kb = koalabox;
+
+    /**
+     * Rough ranking of byte values by how often they occur in x86/x64 machine code,
+     * from the most common to the less common ones. Bytes not listed are considered rare.
+     */
+    constexpr uint8_t COMMON_CODE_BYTES[] = {
+        0x00, 0xFF, 0x48, 0x8B, 0x89, 0x24, 0xE8, 0x4C, 0x0F, 0x01, 0x8D, 0x44, 0x83, 0x85,
+        0x74, 0x75, 0xCC, 0xC3, 0x41, 0x49, 0x45, 0x4D, 0x84, 0xC0, 0x08, 0x10, 0x20, 0x40,
+        0x04, 0x02, 0x03, 0x18, 0x28, 0x30, 0x38, 0x50, 0x54, 0x5C, 0x90, 0xEB, 0xE9, 0xC7,
+        0x31, 0x33, 0x3B, 0x39, 0x80, 0x0D, 0x05, 0x55, 0x53, 0x56, 0x57, 0x5B, 0x5D, 0x5E,
+        0x5F, 0x66, 0xC1, 0xC6, 0x63, 0x8A, 0x88, 0x14, 0x0C, 0x70, 0x60, 0x68,
     };
 
+    constexpr auto COMMON_BYTE_RANKS = [] {
+        std::array<uint8_t, 256> ranks{};
+        ranks.fill(std::size(COMMON_CODE_BYTES));
+
+        for(size_t i = 0; i < std::size(COMMON_CODE_BYTES); ++i) {
+            ranks[COMMON_CODE_BYTES[i]] = static_cast<uint8_t>(i);
+        }
+
+        return ranks;
+    }();
+
+    bool matches_at(const uint8_t* data, const kb::patcher::pattern& pattern, const size_t from = 0) {
+        for(size_t i = from; i < pattern.size(); ++i) {
+            if((data[i] ^ pattern.bytes[i]) & pattern.mask[i]) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
     /**
-     * Converts user-friendly hex pattern string into a byte array
-     * and generates corresponding string mask
+     * Scans [begin, end) for the first occurrence of the pattern.
+     * @return Pointer to the start of the match, or nullptr if there is none.
      */
-    pattern_mask get_pattern_and_mask(std::string pattern) {
-        // Remove whitespaces
-        pattern = std::regex_replace(pattern, std::regex("\\s+"), "");
+    using scanner_t = const uint8_t* (*)(const uint8_t* begin, const uint8_t* end, const kb::patcher::pattern& pattern);
+
+    const uint8_t* scan_scalar(const uint8_t* begin, const uint8_t* end, const kb::patcher::pattern& pattern) {
+        if(static_cast<size_t>(end - begin) < pattern.size()) {
+            return nullptr;
+        }
+
+        const auto* const last = end - pattern.size();
+
+        if(!pattern.mask[pattern.anchor]) {
+            // Pattern consists entirely of wildcards
+            return begin;
+        }
+
+        // memchr is vectorized by the C runtime, which makes it a decent fallback anchor search
+        const auto anchor_byte = pattern.bytes[pattern.anchor];
+        for(const auto* current = begin; current <= last; ++current) {
+            const auto* const hit = static_cast<const uint8_t*>(
+                std::memchr(current + pattern.anchor, anchor_byte, last - current + 1)
+            );
+            if(!hit) {
+                return nullptr;
+            }
+
+            current = hit - pattern.anchor;
+            if(matches_at(current, pattern)) {
+                return current;
+            }
+        }
+
+        return nullptr;
+    }
+
+#ifdef KB_PATCHER_SIMD
+    KB_TARGET("sse2")
+    bool matches_at_sse2(const uint8_t* data, const kb::patcher::pattern& pattern) {
+        size_t i = 0;
+        for(; i + 16 <= pattern.size(); i += 16) {
+            const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern.bytes.data() + i));
+            const auto mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern.mask.data() + i));
+            const auto diff = _mm_and_si128(_mm_xor_si128(chunk, bytes), mask);
+
+            if(_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF) {
+                return false;
+            }
+        }
+
+        return matches_at(data, pattern, i);
+    }
+
+    KB_TARGET("sse2")
+    const uint8_t* scan_sse2(const uint8_t* begin, const uint8_t* end, const kb::patcher::pattern& pattern) {
+        if(static_cast<size_t>(end - begin) < pattern.size() || !pattern.mask[pattern.anchor]) {
+            return scan_scalar(begin, end, pattern);
+        }
+
+        const auto* const last = end - pattern.size();
+        const auto anchor = _mm_set1_epi8(static_cast<char>(pattern.bytes[pattern.anchor]));
+        const auto second_anchor = _mm_set1_epi8(static_cast<char>(pattern.bytes[pattern.second_anchor]));
+
+        // Each iteration tests 16 consecutive candidates. Loads never cross the end of the region,
+        // since both anchors lie within the pattern and the last candidate is at most `last`.
+        const auto* current = begin;
+        for(; last - current >= 15; current += 16) {
+            const auto first_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current + pattern.anchor));
+            const auto second_block = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(current + pattern.second_anchor)
+            );
+
+            auto candidates = static_cast<uint32_t>(_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(first_block, anchor), _mm_cmpeq_epi8(second_block, second_anchor))
+            ));
+
+            while(candidates) {
+                const auto* const candidate = current + std::countr_zero(candidates);
+                if(matches_at_sse2(candidate, pattern)) {
+                    return candidate;
+                }
+                candidates &= candidates - 1;
+            }
+        }
+
+        return scan_scalar(current, end, pattern);
+    }
+
+    KB_TARGET("avx2")
+    bool matches_at_avx2(const uint8_t* data, const kb::patcher::pattern& pattern) {
+        size_t i = 0;
+        for(; i + 32 <= pattern.size(); i += 32) {
+            const auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            const auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pattern.bytes.data() + i));
+            const auto mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pattern.mask.data() + i));
+            const auto diff = _mm256_and_si256(_mm256_xor_si256(chunk, bytes), mask);
+
+            if(!_mm256_testz_si256(diff, diff)) {
+                return false;
+            }
+        }
+
+        return matches_at(data, pattern, i);
+    }
+
+    KB_TARGET("avx2")
+    const uint8_t* scan_avx2(const uint8_t* begin, const uint8_t* end, const kb::patcher::pattern& pattern) {
+        if(static_cast<size_t>(end - begin) < pattern.size() || !pattern.mask[pattern.anchor]) {
+            return scan_scalar(begin, end, pattern);
+        }
 
-        // Convert hex to binary
-        std::stringstream pattern_stream;
-        std::stringstream mask_stream;
-        for(size_t i = 0; i < pattern.length(); i += 2) {
-            const std::string byte_string = pattern.substr(i, 2);
+        const auto* const last = end - pattern.size();
+        const auto anchor = _mm256_set1_epi8(static_cast<char>(pattern.bytes[pattern.anchor]));
+        const auto second_anchor = _mm256_set1_epi8(static_cast<char>(pattern.bytes[pattern.second_anchor]));
 
-            mask_stream << (byte_string == "??" ? '?' : 'x');
+        // Same scheme as scan_sse2, but with 32 candidates per iteration
+        const auto* current = begin;
+        for(; last - current >= 31; current += 32) {
+            const auto first_block = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(current + pattern.anchor)
+            );
+            const auto second_block = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(current + pattern.second_anchor)
+            );
+
+            auto candidates = static_cast<uint32_t>(_mm256_movemask_epi8(
+                _mm256_and_si256(
+                    _mm256_cmpeq_epi8(first_block, anchor),
+                    _mm256_cmpeq_epi8(second_block, second_anchor)
+                )
+            ));
+
+            while(candidates) {
+                const auto* const candidate = current + std::countr_zero(candidates);
+                if(matches_at_avx2(candidate, pattern)) {
+                    return candidate;
+                }
+                candidates &= candidates - 1;
+            }
+        }
 
-            // Handle wildcards ourselves, rest goes to strtol
-            pattern_stream
-                << (byte_string == "??" ? '?' : static_cast<char>(strtol(byte_string.c_str(), nullptr, 16)));
+        return scan_sse2(current, end, pattern);
+    }
+
+    bool is_avx2_supported() {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        if(info[0] < 7) {
+            return false;
+        }
+
+        // AVX registers must be enabled by the OS as well (OSXSAVE + XCR0 bits for XMM & YMM state)
+        __cpuid(info, 1);
+        constexpr auto osxsave_and_avx = (1 << 27) | (1 << 28);
+        if((info[2] & osxsave_and_avx) != osxsave_and_avx || (_xgetbv(0) & 0x6) != 0x6) {
+            return false;
         }
 
-        return {pattern_stream.str(), mask_stream.str()};
+        __cpuidex(info, 7, 0);
+        return info[1] & (1 << 5);
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    bool is_sse2_supported() {
+#if defined(KB_64)
+        return true; // SSE2 is a part of the x64 baseline
+#elif defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 1);
+        return info[3] & (1 << 26);
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+#endif
+    }
+#endif
+
+    scanner_t get_scanner() {
+        static const auto scanner = []() -> scanner_t {
+#ifdef KB_PATCHER_SIMD
+            if(is_avx2_supported()) {
+                LOG_DEBUG("Pattern scanner engine: AVX2");
+                return scan_avx2;
+            }
+
+            if(is_sse2_supported()) {
+                LOG_DEBUG("Pattern scanner engine: SSE2");
+                return scan_sse2;
+            }
+#endif
+            LOG_DEBUG("Pattern scanner engine: scalar");
+            return scan_scalar;
+        }();
+
+        return scanner;
+    }
+
+    uintptr_t find(const uintptr_t base_address, const size_t mem_length, const kb::patcher::pattern& pattern) {
+        const auto* const begin = reinterpret_cast<const uint8_t*>(base_address);
+        const auto* const match = get_scanner()(begin, begin + mem_length, pattern);
+
+        return reinterpret_cast<uintptr_t>(match);
     }
 
-    // Credit: superdoc1234
-    // Source: https://www.unknowncheats.me/forum/1364641-post150.html
-    uintptr_t find(
+    /**
+     * Resumes the scan right past each match, so that every byte of the region is visited only once.
+     * @param max_count Maximum number of matches to collect. 0 means no limit.
+     */
+    std::vector<uintptr_t> find_all(
         const uintptr_t base_address,
         const size_t mem_length,
-        const char* pattern,
-        const char* mask
+        const kb::patcher::pattern& pattern,
+        const size_t max_count
     ) {
-        const auto i_end = strlen(mask) - 1;
+        std::vector<uintptr_t> matches;
 
-        auto DataCompare = [&](const char* data) -> bool {
-            if(data[i_end] != pattern[i_end]) {
-                return false;
+        const auto scanner = get_scanner();
+        const auto* const end = reinterpret_cast<const uint8_t*>(base_address) + mem_length;
+
+        for(
+            auto* current = reinterpret_cast<const uint8_t*>(base_address);
+            max_count == 0 || matches.size() < max_count;
+        ) {
+            const auto* const match = scanner(current, end, pattern);
+            if(!match) {
+                break;
+            }
+
+            matches.push_back(reinterpret_cast<uintptr_t>(match));
+            current = match + 1;
+        }
+
+        return matches;
+    }
+
+    /**
+     * Helper threads of parallel scans. They are started on first use and kept until shutdown,
+     * so that a scan does not pay for creating and joining threads every time.
+     */
+    class scan_thread_pool {
+        std::mutex mutex;
+        std::condition_variable task_condition;
+        std::condition_variable done_condition;
+        std::deque<std::function<void()>> tasks;
+        std::vector<std::thread> threads;
+        bool stopping = false;
+
+        void run_tasks() {
+            while(true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock lock(mutex);
+                    task_condition.wait(lock, [&] { return stopping || !tasks.empty(); });
+
+                    // Pending tasks are still run, since a scan waits for them to finish
+                    if(tasks.empty()) {
+                        return;
+                    }
+
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+
+                task();
+            }
+        }
+
+    public:
+        explicit scan_thread_pool(const unsigned thread_count) {
+            for(unsigned i = 0; i < thread_count; ++i) {
+                threads.emplace_back(&scan_thread_pool::run_tasks, this);
             }
+        }
+
+        scan_thread_pool(const scan_thread_pool&) = delete;
+        scan_thread_pool& operator=(const scan_thread_pool&) = delete;
+
+        ~scan_thread_pool() {
+            stop();
+        }
+
+        [[nodiscard]] unsigned size() const {
+            return static_cast<unsigned>(threads.size());
+        }
+
+        /**
+         * Lets the threads finish pending tasks and joins them. Scans started afterwards run on the calling thread only.
+         */
+        void stop() {
+            {
+                const std::lock_guard lock(mutex);
+                stopping = true;
+            }
+            task_condition.notify_all();
 
-            for(size_t i = 0; i <= i_end; ++i) {
-                if(mask[i] == 'x' && data[i] != pattern[i]) {
-                    return false;
+            for(auto& thread : threads) {
+                if(thread.joinable()) {
+                    thread.join();
                 }
             }
+        }
+
+        /**
+         * Runs the job on the calling thread and on up to the given number of pool threads at once,
+         * and returns once all of them are done. The job must tolerate running on the calling thread alone.
+         * If any of them throws, the first exception is rethrown after all of them are done.
+         */
+        void run(const std::function<void()>& job, unsigned helper_count) {
+            // Only accessed under the mutex. Helpers never touch it or the job once they have counted down,
+            // and the condition they notify belongs to the pool, so both may safely live on this stack.
+            unsigned remaining = 0;
+            std::exception_ptr exception;
+
+            const auto record_exception = [&](std::exception_ptr current) {
+                if(!exception) {
+                    exception = std::move(current);
+                }
+            };
+
+            {
+                const std::lock_guard lock(mutex);
+                if(stopping) {
+                    helper_count = 0;
+                }
 
-            return true;
+                remaining = helper_count;
+                for(unsigned i = 0; i < helper_count; ++i) {
+                    tasks.emplace_back(
+                        [&] {
+                            std::exception_ptr current;
+                            try {
+                                job();
+                            } catch(...) {
+                                current = std::current_exception();
+                            }
+
+                            const std::lock_guard task_lock(mutex);
+                            if(current) {
+                                record_exception(std::move(current));
+                            }
+
+                            // Notified under the lock, so that the caller cannot return before the helper is done
+                            --remaining;
+                            done_condition.notify_all();
+                        }
+                    );
+                }
+            }
+            task_condition.notify_all();
+
+            std::exception_ptr current;
+            try {
+                job();
+            } catch(...) {
+                current = std::current_exception();
+            }
+
+            std::unique_lock lock(mutex);
+            done_condition.wait(lock, [&] { return remaining == 0; });
+
+            if(current) {
+                record_exception(std::move(current));
+            }
+
+            if(exception) {
+                std::rethrow_exception(exception);
+            }
+        }
+    };
+
+    std::mutex& get_scan_thread_pool_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    std::shared_ptr<scan_thread_pool>& get_scan_thread_pool_instance() {
+        // Never destroyed, since joining threads during static destruction could deadlock while a DLL is unloaded.
+        // Hosts are expected to stop the pool via koalabox::patcher::shutdown instead.
+        static auto* const pool = new std::shared_ptr<scan_thread_pool>();
+        return *pool;
+    }
+
+    /**
+     * Shared, so that a scan keeps its pool alive even if the pool is shut down in the meantime.
+     */
+    std::shared_ptr<scan_thread_pool> get_scan_thread_pool() {
+        const std::lock_guard lock(get_scan_thread_pool_mutex());
+
+        auto& pool = get_scan_thread_pool_instance();
+        if(!pool) {
+            pool = std::make_shared<scan_thread_pool>(std::max(1U, std::thread::hardware_concurrency()) - 1);
+        }
+
+        return pool;
+    }
+
+    /**
+     * Splits the region into chunks of candidate start positions and scans them concurrently.
+     * Adjacent chunks overlap by (pattern size - 1) bytes, so that matches straddling a chunk
+     * boundary are still found. Chunks are claimed in ascending order and the lowest chunk with a match
+     * wins, so the result is always identical to that of a sequential scan.
+     */
+    uintptr_t find_parallel(
+        const uintptr_t base_address,
+        const size_t mem_length,
+        const kb::patcher::pattern& pattern,
+        unsigned thread_count
+    ) {
+        // Large enough to amortize thread synchronization, small enough to balance the load
+        constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+        if(mem_length < pattern.size()) {
+            return 0;
+        }
+
+        const auto candidate_count = mem_length - pattern.size() + 1;
+        const auto chunk_count = (candidate_count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+        if(thread_count == 1 || chunk_count == 1) {
+            return find(base_address, mem_length, pattern);
+        }
+
+        const auto pool = get_scan_thread_pool();
+
+        // The calling thread takes part in the scan as well
+        if(thread_count == 0 || thread_count > pool->size() + 1) {
+            thread_count = pool->size() + 1;
+        }
+        thread_count = static_cast<unsigned>(std::min<size_t>(thread_count, chunk_count));
+
+        if(thread_count <= 1) {
+            return find(base_address, mem_length, pattern);
+        }
+
+        const auto* const begin = reinterpret_cast<const uint8_t*>(base_address);
+        const auto* const end = begin + mem_length;
+        const auto scanner = get_scanner();
+
+        std::vector<const uint8_t*> chunk_matches(chunk_count, nullptr);
+        std::atomic<size_t> next_chunk = 0;
+        std::atomic<size_t> first_matched_chunk = chunk_count;
+
+        const auto worker = [&] {
+            while(true) {
+                const auto chunk = next_chunk.fetch_add(1, std::memory_order_relaxed);
+
+                // Chunks are claimed in ascending order, hence all subsequent ones can be skipped as well
+                if(chunk >= first_matched_chunk.load(std::memory_order_relaxed)) {
+                    return;
+                }
+
+                const auto* const chunk_begin = begin + chunk * CHUNK_SIZE;
+                const auto* const chunk_end = std::min(chunk_begin + CHUNK_SIZE + pattern.size() - 1, end);
+
+                if(const auto* const match = scanner(chunk_begin, chunk_end, pattern)) {
+                    chunk_matches[chunk] = match;
+
+                    auto current = first_matched_chunk.load(std::memory_order_relaxed);
+                    while(chunk < current && !first_matched_chunk.compare_exchange_weak(current, chunk)) {}
+                }
+            }
         };
 
-        for(size_t i = 0; i < mem_length - strlen(mask); ++i) {
-            if(DataCompare(reinterpret_cast<char*>(base_address + i))) {
-                return base_address + i;
+        pool->run(worker, thread_count - 1);
+
+        const auto first_chunk = first_matched_chunk.load();
+        return first_chunk < chunk_count ? reinterpret_cast<uintptr_t>(chunk_matches[first_chunk]) : 0;
+    }
+    /**
+     * Aho-Corasick automaton over a fixed-byte run ("literal") of each pattern. Feeding the region
+     * through it byte by byte reports every literal occurrence of every pattern in a single pass,
+     * after which only the reported candidates need a full masked comparison.
+     */
+    class pattern_automaton {
+        // Literals are capped to keep the transition table small enough to stay in cache.
+        // Past a handful of bytes, a longer literal barely reduces the number of false candidates.
+        static constexpr size_t MAX_LITERAL_SIZE = 8;
+
+        struct literal_t {
+            size_t offset; // Offset of the literal within the pattern
+            size_t size;
+        };
+
+        std::vector<const kb::patcher::pattern*> patterns;
+        std::vector<literal_t> literals;
+        std::vector<std::array<uint32_t, 256>> transitions;
+        // Indices of patterns whose literal ends at a given state, including those of its suffix states.
+        std::vector<std::vector<uint32_t>> outputs;
+
+        static literal_t find_longest_literal(const kb::patcher::pattern& pattern) {
+            literal_t longest{0, 0};
+
+            for(size_t i = 0; i < pattern.size();) {
+                if(!pattern.mask[i]) {
+                    ++i;
+                    continue;
+                }
+
+                const auto start = i;
+                while(i < pattern.size() && pattern.mask[i]) {
+                    ++i;
+                }
+
+                if(i - start > longest.size) {
+                    longest = {start, i - start};
+                }
+            }
+
+            // Prefer the tail of the run, since it holds the rarer bytes in typical prologue-based patterns
+            if(longest.size > MAX_LITERAL_SIZE) {
+                longest.offset += longest.size - MAX_LITERAL_SIZE;
+                longest.size = MAX_LITERAL_SIZE;
+            }
+
+            return longest;
+        }
+
+        uint32_t add_state() {
+            transitions.emplace_back().fill(0);
+            outputs.emplace_back();
+            return static_cast<uint32_t>(transitions.size() - 1);
+        }
+
+    public:
+        explicit pattern_automaton(std::vector<const kb::patcher::pattern*> scan_patterns)
+            : patterns(std::move(scan_patterns)) {
+            add_state(); // root
+
+            // Build the trie. Zero transitions denote missing edges until they are filled in below.
+            for(uint32_t index = 0; index < patterns.size(); ++index) {
+                const auto& pattern = *patterns[index];
+                const auto& literal = literals.emplace_back(find_longest_literal(pattern));
+
+                if(literal.size == 0) {
+                    continue; // Wildcard-only patterns are handled separately
+                }
+
+                uint32_t state = 0;
+                for(size_t i = literal.offset; i < literal.offset + literal.size; ++i) {
+                    const auto byte = pattern.bytes[i];
+                    if(!transitions[state][byte]) {
+                        const auto next_state = add_state();
+                        transitions[state][byte] = next_state;
+                    }
+                    state = transitions[state][byte];
+                }
+
+                outputs[state].push_back(index);
+            }
+
+            // Convert the trie into a DFA by breadth-first traversal, resolving each missing edge
+            // to the edge of the longest proper suffix state and inheriting its outputs.
+            std::vector<uint32_t> suffix_links(transitions.size(), 0);
+            std::deque<uint32_t> queue;
+
+            for(const auto next_state : transitions[0]) {
+                if(next_state) {
+                    queue.push_back(next_state);
+                }
+            }
+
+            while(!queue.empty()) {
+                const auto state = queue.front();
+                queue.pop_front();
+
+                const auto suffix = suffix_links[state];
+                outputs[state].insert(outputs[state].end(), outputs[suffix].begin(), outputs[suffix].end());
+
+                for(size_t byte = 0; byte < 256; ++byte) {
+                    if(const auto next_state = transitions[state][byte]) {
+                        suffix_links[next_state] = transitions[suffix][byte];
+                        queue.push_back(next_state);
+                    } else {
+                        transitions[state][byte] = transitions[suffix][byte];
+                    }
+                }
+            }
+        }
+
+        /**
+         * @return Address of the first match of each pattern, or nullptr for patterns without a match.
+         */
+        [[nodiscard]] std::vector<const uint8_t*> scan(const uint8_t* begin, const uint8_t* end) const {
+            std::vector<const uint8_t*> matches(patterns.size(), nullptr);
+            size_t remaining = patterns.size();
+
+            const auto region_size = static_cast<size_t>(end - begin);
+            for(size_t index = 0; index < patterns.size(); ++index) {
+                if(patterns[index]->size() > region_size) {
+                    --remaining;
+                } else if(literals[index].size == 0) {
+                    matches[index] = begin;
+                    --remaining;
+                }
+            }
+
+            uint32_t state = 0;
+            for(const auto* current = begin; current < end && remaining; ++current) {
+                state = transitions[state][*current];
+
+                for(const auto index : outputs[state]) {
+                    if(matches[index]) {
+                        continue;
+                    }
+
+                    const auto& pattern = *patterns[index];
+                    const auto literal_end = literals[index].offset + literals[index].size;
+                    if(static_cast<size_t>(current - begin) + 1 < literal_end) {
+                        continue; // Pattern would start before the region
+                    }
+
+                    const auto* const candidate = current + 1 - literal_end;
+                    if(static_cast<size_t>(end - candidate) >= pattern.size() && matches_at(candidate, pattern)) {
+                        matches[index] = candidate;
+                        --remaining;
+                    }
+                }
+            }
+
+            return matches;
+        }
+    };
+    /**
+     * Identifies a particular build of a module on disk by its file size and modification time.
+     * The cache entry of a module is discarded as soon as its identity changes, e.g. after a game update.
+     */
+    std::optional<std::string> get_module_identity(const std::filesystem::path& module_path) {
+        std::error_code error;
+        const auto file_size = std::filesystem::file_size(module_path, error);
+        if(error) {
+            return std::nullopt;
+        }
+
+        const auto write_time = std::filesystem::last_write_time(module_path, error);
+        if(error) {
+            return std::nullopt;
+        }
+
+        return std::format("{}:{}", file_size, write_time.time_since_epoch().count());
+    }
+
+    /**
+     * Cached pattern offsets of a module, loaded from disk on first use and kept in memory afterwards,
+     * so that lookups neither re-read the cache file nor wait for each other's scans.
+     */
+    struct module_cache_t {
+        std::string identity;
+        nlohmann::json patterns = nlohmann::json::object(); // Key is pattern, value is offset from module base
+    };
+
+    // Key is cache key of the module
+    std::map<std::string, module_cache_t>& get_module_caches() {
+        static std::map<std::string, module_cache_t> module_caches;
+        return module_caches;
+    }
+
+    // Guards the module caches. Never held while scanning or writing to disk.
+    std::mutex& get_cache_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    // Serializes writes, so that a later snapshot of a module cache is never overwritten by an earlier one
+    std::mutex& get_cache_write_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    /** Must be called with the cache mutex held. */
+    module_cache_t& get_module_cache(const std::string& cache_key, const std::string& identity) {
+        auto& module_caches = get_module_caches();
+
+        auto it = module_caches.find(cache_key);
+        if(it == module_caches.end()) {
+            module_cache_t module_cache{.identity = identity};
+
+            try {
+                const auto entry = kb::cache::get(cache_key, nlohmann::json::object());
+                if(entry.is_object() && entry.value("identity", "") == identity && entry.contains("patterns")) {
+                    module_cache.patterns = entry["patterns"];
+                }
+            } catch(const std::exception& e) {
+                LOG_DEBUG("Failed to read patcher cache: {}", e.what());
             }
+
+            it = module_caches.emplace(cache_key, std::move(module_cache)).first;
+        }
+
+        // Module may have been replaced on disk since the entry was loaded
+        if(auto& module_cache = it->second; module_cache.identity != identity) {
+            module_cache = {.identity = identity};
         }
 
-        return 0;
+        return it->second;
     }
 }
 
 namespace koalabox::patcher {
+    namespace details {
+        bool is_engine_supported(const scan_engine engine) {
+            switch(engine) {
+            case scan_engine::scalar:
+                return true;
+#ifdef KB_PATCHER_SIMD
+            case scan_engine::sse2:
+                return is_sse2_supported();
+            case scan_engine::avx2:
+                return is_avx2_supported();
+#endif
+            default:
+                return false;
+            }
+        }
+
+        uintptr_t find_with_engine(
+            const scan_engine engine,
+            const uintptr_t base_address,
+            const size_t scan_size,
+            const pattern& pattern
+        ) {
+            if(!is_engine_supported(engine)) {
+                throw std::invalid_argument("Scan engine is not supported");
+            }
+
+            const auto scanner = [&]() -> scanner_t {
+                switch(engine) {
+#ifdef KB_PATCHER_SIMD
+                case scan_engine::sse2:
+                    return scan_sse2;
+                case scan_engine::avx2:
+                    return scan_avx2;
+#endif
+                default:
+                    return scan_scalar;
+                }
+            }();
+
+            const auto* const begin = reinterpret_cast<const uint8_t*>(base_address);
+            return reinterpret_cast<uintptr_t>(scanner(begin, begin + scan_size, pattern));
+        }
+    }
+
+    pattern::pattern(std::vector<uint8_t> bytes, std::vector<uint8_t> mask)
+        : bytes(std::move(bytes)), mask(std::move(mask)) {
+        if(this->bytes.empty() || this->bytes.size() != this->mask.size()) {
+            throw std::invalid_argument("Pattern bytes and mask must be non-empty and of equal size");
+        }
+
+        std::optional<size_t> rarest;
+        for(size_t i = 0; i < size(); ++i) {
+            if(this->mask[i] && (!rarest || COMMON_BYTE_RANKS[this->bytes[i]] > COMMON_BYTE_RANKS[this->bytes[*rarest]])) {
+                rarest = i;
+            }
+        }
+
+        anchor = rarest.value_or(0);
+        second_anchor = anchor;
+
+        // The furthest fixed byte from the anchor is the least likely to be correlated with it
+        const auto distance = [&](const size_t i) {
+            return i > anchor ? i - anchor : anchor - i;
+        };
+        for(size_t i = 0; i < size(); ++i) {
+            if(this->mask[i] && distance(i) > distance(second_anchor)) {
+                second_anchor = i;
+            }
+        }
+    }
+
+    pattern pattern::from_str(const std::string_view hex) {
+        std::vector<uint8_t> bytes;
+        std::vector<uint8_t> mask;
+        bytes.reserve(hex.size() / 2);
+        mask.reserve(hex.size() / 2);
+
+        details::parse_pattern(
+            hex,
+            [&](const uint8_t byte, const bool is_wildcard) {
+                bytes.push_back(byte);
+                mask.push_back(is_wildcard ? 0x00 : 0xFF);
+            }
+        );
+
+        return {std::move(bytes), std::move(mask)};
+    }
+
+    std::string pattern::to_string() const {
+        std::string result;
+        result.reserve(size() * 3);
+
+        for(size_t i = 0; i < size(); ++i) {
+            if(i) {
+                result += ' ';
+            }
+            result += mask[i] ? std::format("{:02X}", bytes[i]) : "??";
+        }
+
+        return result;
+    }
+
     uintptr_t find_pattern_address(
         const uintptr_t base_address,
         const size_t scan_size,
         const std::string& name,
         const std::string& pattern
+    ) {
+        return find_pattern_address_parallel(base_address, scan_size, name, pattern, 1);
+    }
+
+    uintptr_t find_pattern_address(
+        const uintptr_t base_address,
+        const size_t scan_size,
+        const std::string& name,
+        const patcher::pattern& pattern
+    ) {
+        return find_pattern_address_parallel(base_address, scan_size, name, pattern, 1);
+    }
+
+    uintptr_t find_pattern_address_parallel(
+        const uintptr_t base_address,
+        const size_t scan_size,
+        const std::string& name,
+        const std::string& pattern,
+        const unsigned thread_count
+    ) {
+        try {
+            return find_pattern_address_parallel(
+                base_address, scan_size, name, patcher::pattern::from_str(pattern), thread_count
+            );
+        } catch(const std::invalid_argument& e) {
+            LOG_ERROR("Invalid pattern of '{}': {}", name, e.what());
+            return 0;
+        }
+    }
+
+    uintptr_t find_pattern_address_parallel(
+        const uintptr_t base_address,
+        const size_t scan_size,
+        const std::string& name,
+        const patcher::pattern& pattern,
+        const unsigned thread_count
     ) {
         const auto t1 = std::chrono::high_resolution_clock::now();
 
@@ -84,8 +931,68 @@ namespace koalabox::patcher {
             reinterpret_cast<void*>(base_address + scan_size)
         );
 
-        auto [binaryPattern, mask] = get_pattern_and_mask(pattern);
-        const auto address = find(base_address, scan_size, binaryPattern.c_str(), mask.c_str());
+        const auto address = find_parallel(base_address, scan_size, pattern, thread_count);
+
+        const auto t2 = std::chrono::high_resolution_clock::now();
+        const double elapsed_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        if(address) {
+            LOG_DEBUG(
+                "'{}' address: {}. Search time: {:.2f} ms",
+                name,
+                reinterpret_cast<void*>(address),
+                elapsed_time
+            );
+        } else {
+            LOG_ERROR("Failed to find address of '{}'. Search time: {:.2f} ms", name, elapsed_time);
+        }
+
+        return address;
+    }
+
+    uintptr_t find_in_module(
+        void* const module_handle,
+        const std::string& name,
+        const std::string& pattern,
+        const bool parallel
+    ) {
+        try {
+            return find_in_module(module_handle, name, patcher::pattern::from_str(pattern), parallel);
+        } catch(const std::invalid_argument& e) {
+            LOG_ERROR("Invalid pattern of '{}': {}", name, e.what());
+            return 0;
+        }
+    }
+
+    uintptr_t find_in_module(
+        void* const module_handle,
+        const std::string& name,
+        const patcher::pattern& pattern,
+        const bool parallel
+    ) {
+        const auto t1 = std::chrono::high_resolution_clock::now();
+
+        const auto regions = lib::get_executable_regions(module_handle);
+        if(regions.empty()) {
+            LOG_ERROR("No executable regions found in module {}", module_handle);
+            return 0;
+        }
+
+        uintptr_t address = 0;
+        for(const auto& region : regions) {
+            LOG_TRACE("Scanning region {}-{}", region.start_address, region.end_address);
+
+            address = find_parallel(
+                reinterpret_cast<uintptr_t>(region.start_address),
+                region.size,
+                pattern,
+                parallel ? 0 : 1
+            );
+
+            if(address) {
+                break;
+            }
+        }
 
         const auto t2 = std::chrono::high_resolution_clock::now();
         const double elapsed_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
@@ -103,4 +1010,253 @@ namespace koalabox::patcher {
 
         return address;
     }
+
+    void shutdown() {
+        std::shared_ptr<scan_thread_pool> pool;
+        {
+            const std::lock_guard lock(get_scan_thread_pool_mutex());
+            pool = std::move(get_scan_thread_pool_instance());
+        }
+
+        if(pool) {
+            pool->stop();
+        }
+    }
+
+    std::vector<uintptr_t> find_all_pattern_addresses(
+        const uintptr_t base_address,
+        const size_t scan_size,
+        const std::string& name,
+        const std::string& pattern,
+        const size_t max_count
+    ) {
+        try {
+            return find_all_pattern_addresses(
+                base_address, scan_size, name, patcher::pattern::from_str(pattern), max_count
+            );
+        } catch(const std::invalid_argument& e) {
+            LOG_ERROR("Invalid pattern of '{}': {}", name, e.what());
+            return {};
+        }
+    }
+
+    std::vector<uintptr_t> find_all_pattern_addresses(
+        const uintptr_t base_address,
+        const size_t scan_size,
+        const std::string& name,
+        const patcher::pattern& pattern,
+        const size_t max_count
+    ) {
+        const auto t1 = std::chrono::high_resolution_clock::now();
+
+        LOG_TRACE(
+            "Scanning region {}-{} for all matches",
+            reinterpret_cast<void*>(base_address),
+            reinterpret_cast<void*>(base_address + scan_size)
+        );
+
+        auto addresses = find_all(base_address, scan_size, pattern, max_count);
+
+        const auto t2 = std::chrono::high_resolution_clock::now();
+        const double elapsed_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        LOG_DEBUG("'{}' matches: {}. Search time: {:.2f} ms", name, addresses.size(), elapsed_time);
+
+        return addresses;
+    }
+
+    uintptr_t find_unique_pattern_address(
+        const uintptr_t base_address,
+        const size_t scan_size,
+        const std::string& name,
+        const std::string& pattern
+    ) {
+        try {
+            return find_unique_pattern_address(base_address, scan_size, name, patcher::pattern::from_str(pattern));
+        } catch(const std::invalid_argument& e) {
+            LOG_ERROR("Invalid pattern of '{}': {}", name, e.what());
+            return 0;
+        }
+    }
+
+    uintptr_t find_unique_pattern_address(
+        const uintptr_t base_address,
+        const size_t scan_size,
+        const std::string& name,
+        const patcher::pattern& pattern
+    ) {
+        // A second match is all it takes to prove the pattern ambiguous
+        const auto addresses = find_all_pattern_addresses(base_address, scan_size, name, pattern, 2);
+
+        if(addresses.empty()) {
+            LOG_ERROR("Failed to find address of '{}'", name);
+            return 0;
+        }
+
+        if(addresses.size() > 1) {
+            LOG_ERROR(
+                "Pattern of '{}' is ambiguous. It matches at {} and {} at least",
+                name,
+                reinterpret_cast<void*>(addresses[0]),
+                reinterpret_cast<void*>(addresses[1])
+            );
+            return 0;
+        }
+
+        LOG_DEBUG("'{}' address: {}", name, reinterpret_cast<void*>(addresses.front()));
+
+        return addresses.front();
+    }
+
+    std::map<std::string, uintptr_t> find_pattern_addresses(
+        const uintptr_t base_address,
+        const size_t scan_size,
+        const std::map<std::string, std::string>& patterns
+    ) {
+        std::map<std::string, patcher::pattern> parsed_patterns;
+        for(const auto& [name, pattern] : patterns) {
+            try {
+                parsed_patterns.emplace(name, patcher::pattern::from_str(pattern));
+            } catch(const std::invalid_argument& e) {
+                LOG_ERROR("Invalid pattern of '{}': {}", name, e.what());
+            }
+        }
+
+        return find_pattern_addresses(base_address, scan_size, parsed_patterns);
+    }
+
+    std::map<std::string, uintptr_t> find_pattern_addresses(
+        const uintptr_t base_address,
+        const size_t scan_size,
+        const std::map<std::string, patcher::pattern>& patterns
+    ) {
+        const auto t1 = std::chrono::high_resolution_clock::now();
+
+        LOG_TRACE(
+            "Scanning region {}-{} for {} patterns",
+            reinterpret_cast<void*>(base_address),
+            reinterpret_cast<void*>(base_address + scan_size),
+            patterns.size()
+        );
+
+        std::vector<const std::string*> names;
+        std::vector<const patcher::pattern*> scan_patterns;
+        for(const auto& [name, pattern] : patterns) {
+            names.push_back(&name);
+            scan_patterns.push_back(&pattern);
+        }
+
+        const auto* const begin = reinterpret_cast<const uint8_t*>(base_address);
+        const auto matches = pattern_automaton(std::move(scan_patterns)).scan(begin, begin + scan_size);
+
+        const auto t2 = std::chrono::high_resolution_clock::now();
+        const double elapsed_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        std::map<std::string, uintptr_t> addresses;
+        for(size_t i = 0; i < names.size(); ++i) {
+            if(matches[i]) {
+                addresses[*names[i]] = reinterpret_cast<uintptr_t>(matches[i]);
+                LOG_DEBUG("'{}' address: {}", *names[i], static_cast<const void*>(matches[i]));
+            } else {
+                LOG_ERROR("Failed to find address of '{}'", *names[i]);
+            }
+        }
+
+        LOG_DEBUG(
+            "Found {} of {} patterns. Search time: {:.2f} ms",
+            addresses.size(),
+            patterns.size(),
+            elapsed_time
+        );
+
+        return addresses;
+    }
+
+    uintptr_t find_pattern_address_cached(
+        void* const module_handle,
+        const uintptr_t base_address,
+        const size_t scan_size,
+        const std::string& name,
+        const std::string& pattern
+    ) {
+        try {
+            return find_pattern_address_cached(
+                module_handle, base_address, scan_size, name, patcher::pattern::from_str(pattern)
+            );
+        } catch(const std::invalid_argument& e) {
+            LOG_ERROR("Invalid pattern of '{}': {}", name, e.what());
+            return 0;
+        }
+    }
+
+    uintptr_t find_pattern_address_cached(
+        void* const module_handle,
+        const uintptr_t base_address,
+        const size_t scan_size,
+        const std::string& name,
+        const patcher::pattern& pattern
+    ) {
+        const auto module_base = lib::get_base_address(module_handle);
+        const auto module_path = lib::get_fs_path(module_handle);
+        const auto identity = get_module_identity(module_path);
+
+        if(!module_base || !identity) {
+            LOG_WARN("Failed to identify module of '{}'. Falling back to regular scan.", name);
+            return find_pattern_address(base_address, scan_size, name, pattern);
+        }
+
+        // Cache entries have the following format:
+        // {"identity": "size:mtime", "patterns": {"48 8B ?? ...": rva}}
+        // Keyed by the full path, since modules in different directories may share a file name
+        const auto cache_key = std::format("patcher:{}", path::to_str(module_path));
+        const auto pattern_key = pattern.to_string();
+        const auto module_address = reinterpret_cast<uintptr_t>(*module_base);
+
+        std::optional<uintptr_t> cached_offset;
+        {
+            const std::lock_guard lock(get_cache_mutex());
+
+            const auto& cached_patterns = get_module_cache(cache_key, *identity).patterns;
+            if(const auto it = cached_patterns.find(pattern_key);
+                it != cached_patterns.end() && it->is_number_unsigned()) {
+                cached_offset = it->get<uintptr_t>();
+            }
+        }
+
+        if(cached_offset) {
+            // Re-comparing the pattern at the cached offset is cheap and guards against stale entries
+            const auto address = module_address + *cached_offset;
+            if(
+                address >= base_address &&
+                address - base_address + pattern.size() <= scan_size &&
+                matches_at(reinterpret_cast<const uint8_t*>(address), pattern)
+            ) {
+                LOG_DEBUG("'{}' address: {} (cached)", name, reinterpret_cast<void*>(address));
+                return address;
+            }
+
+            LOG_DEBUG("Discarding stale cached address of '{}'", name);
+        }
+
+        const auto address = find_pattern_address(base_address, scan_size, name, pattern);
+        if(!address) {
+            return 0;
+        }
+
+        const std::lock_guard write_lock(get_cache_write_mutex());
+
+        nlohmann::json entry;
+        {
+            const std::lock_guard lock(get_cache_mutex());
+
+            auto& module_cache = get_module_cache(cache_key, *identity);
+            module_cache.patterns[pattern_key] = address - module_address;
+
+            entry = {{"identity", module_cache.identity}, {"patterns", module_cache.patterns}};
+        }
+
+        cache::put(cache_key, entry);
+
+        return address;
+    }
 }
@@ -1,6 +1,8 @@
 #include <algorithm>
 #include <cstdint>
+#include <mutex>
 #include <optional>
+#include <shared_mutex>
 #include <vector>
 
 #include <elf.h> // PT_LOAD, PT_GNU_EH_FRAME
@@ -26,16 +28,21 @@ namespace {
         uint32_t fde_count; // number of entries in the binary-search table
     };
 
-    // Lazily-populated, append-only cache of modules we have already resolved. The interface and
-    // family-bypass scans probe the same module up to millions of times, so each module's unwind
-    // table is resolved once (one dl_iterate_phdr walk) and then binary-searched in place.
+    // Lazily-populated cache of modules we have already resolved, pruned only on module unload.
+    // The interface and family-bypass scans probe the same module up to millions of times, so each
+    // module's unwind table is resolved once (one dl_iterate_phdr walk) and then binary-searched in place.
     //
-    // Not synchronized: steamclient analysis runs single-threaded during injection startup.
+    // Guarded by module_cache_mutex(), since lib_monitor invalidates it on whichever thread unloads a module.
     std::vector<module_unwind_t>& module_cache() {
         static std::vector<module_unwind_t> cache;
         return cache;
     }
 
+    std::shared_mutex& module_cache_mutex() {
+        static std::shared_mutex mutex;
+        return mutex;
+    }
+
     // Walks loaded modules to find the one containing @p pc, recording its address span and (when
     // present and supported) its parsed .eh_frame_hdr. range_hi is left 0 if no module contains pc.
     module_unwind_t resolve_module(const uintptr_t pc) {
@@ -106,27 +113,44 @@ namespace {
         return context.result;
     }
 
-    const module_unwind_t* get_cached_module(const uintptr_t pc) {
-        for(const auto& module : module_cache()) {
-            if(pc >= module.range_lo && pc < module.range_hi) {
-                return &module;
+    // Returned by value, since an entry may be pruned by another thread as soon as the lock is released.
+    std::optional<module_unwind_t> get_cached_module(const uintptr_t pc) {
+        const auto find_module = [&]() -> std::optional<module_unwind_t> {
+            for(const auto& module : module_cache()) {
+                if(pc >= module.range_lo && pc < module.range_hi) {
+                    return module;
+                }
+            }
+            return std::nullopt;
+        };
+
+        {
+            const std::shared_lock lock(module_cache_mutex());
+            if(auto module = find_module()) {
+                return module;
             }
         }
 
         const auto resolved = resolve_module(pc);
         if(resolved.range_hi == 0) {
-            return nullptr; // pc is not inside any loaded module
+            return std::nullopt; // pc is not inside any loaded module
+        }
+
+        const std::unique_lock lock(module_cache_mutex());
+        // Another thread may have resolved the same module in the meantime
+        if(auto module = find_module()) {
+            return module;
         }
 
         module_cache().push_back(resolved);
-        return &module_cache().back();
+        return resolved;
     }
 }
 
 namespace koalabox::re {
     std::optional<uintptr_t> get_function_start(const uintptr_t address) {
-        const auto* const module = get_cached_module(address);
-        if(module == nullptr || module->eh_frame_hdr == 0 || module->fde_count == 0) {
+        const auto module = get_cached_module(address);
+        if(!module || module->eh_frame_hdr == 0 || module->fde_count == 0) {
             return std::nullopt;
         }
 
@@ -161,4 +185,15 @@ namespace koalabox::re {
 
         return function_start;
     }
+
+    void invalidate_cache(const uintptr_t start_address, const uintptr_t end_address) {
+        const std::unique_lock lock(module_cache_mutex());
+
+        std::erase_if(
+            module_cache(),
+            [&](const module_unwind_t& module) {
+                return module.range_lo < end_address && start_address < module.range_hi;
+            }
+        );
+    }
 }
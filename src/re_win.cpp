@@ -77,3 +77,9 @@ namespace koalabox::re {
 }
 
 #endif
+
+namespace koalabox::re {
+    void invalidate_cache(uintptr_t /*start_address*/, uintptr_t /*end_address*/) {
+        // Nothing to invalidate: the loader keeps function tables of every module, and drops them on unload
+    }
+}
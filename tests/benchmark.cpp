@@ -0,0 +1,143 @@
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "koalabox/hook.hpp"
+#include "koalabox/logger.hpp"
+#include "koalabox/patcher.hpp"
+#include "koalabox/re.hpp"
+
+// Benchmarks are tagged with [!benchmark], so they are hidden from regular runs.
+// Run them explicitly with: KoalaBoxBenchmarks "[!benchmark]"
+
+#if defined(_MSC_VER)
+#define KB_BENCH_NOINLINE __declspec(noinline)
+#else
+#define KB_BENCH_NOINLINE [[gnu::noinline]]
+#endif
+
+namespace {
+    constexpr size_t BUFFER_SIZE = 64 * 1024 * 1024;
+
+    // Random bytes skewed towards the values that dominate x86 code, so that common pattern bytes
+    // produce a realistic amount of false candidates.
+    const std::vector<uint8_t>& get_code_like_buffer() {
+        static const auto buffer = [] {
+            constexpr uint8_t common_bytes[] = {0x00, 0xFF, 0x48, 0x8B, 0x89, 0x24, 0xE8, 0x4C, 0x0F, 0xCC};
+
+            std::mt19937 rng(1337); // NOLINT(*-msc51-cpp)
+            std::vector<uint8_t> result(BUFFER_SIZE);
+            for(auto& byte : result) {
+                const auto value = rng();
+                byte = value % 2 ? common_bytes[(value >> 1) % std::size(common_bytes)] : static_cast<uint8_t>(value >> 8);
+            }
+
+            return result;
+        }();
+
+        return buffer;
+    }
+
+    uintptr_t get_buffer_address() {
+        return reinterpret_cast<uintptr_t>(get_code_like_buffer().data());
+    }
+
+    // None of these are planted in the buffer, so each benchmark measures a full sweep of the region
+    const std::map<std::string, std::string> PATTERNS = {
+        {"short", "48 8B 05 11 22 33"},
+        {"wildcards", "E8 ?? ?? ?? ?? 84 C0 0F 84 ?? ?? ?? ?? 48 8B 0D"},
+        {"leading_wildcards", "?? ?? ?? ?? 4C 8D 05 DE AD BE EF"},
+        {"common_bytes", "00 00 00 00 ?? FF FF FF FF 00 00 48"},
+        {"long", "40 53 48 83 EC 20 48 8B D9 E8 ?? ?? ?? ?? 48 8B CB 48 83 C4 20 5B E9 ?? ?? ?? ?? CC CC CC CC CC"},
+    };
+
+    KB_BENCH_NOINLINE int sink(const int value) {
+        volatile int v = value;
+        return v;
+    }
+
+    // Has a long enough body for a detour to relocate its prologue
+    KB_BENCH_NOINLINE int detour_target(const int seed) {
+        int acc = seed;
+        for(int i = 0; i < 13; ++i) {
+            acc = sink(acc * 7 + i);
+        }
+        return acc;
+    }
+
+    KB_BENCH_NOINLINE int detour_callback(const int seed) {
+        return sink(seed);
+    }
+}
+
+TEST_CASE("Pattern scanning", "[!benchmark][patcher]") {
+    koalabox::logger::init_null_logger();
+
+    const auto base = get_buffer_address();
+
+    // Structured bindings are avoided, since not every supported compiler can capture them in lambdas
+    for(const auto& entry : PATTERNS) {
+        BENCHMARK("find_pattern_address: " + entry.first) {
+            return koalabox::patcher::find_pattern_address(base, BUFFER_SIZE, entry.first, entry.second);
+        };
+    }
+
+    for(const auto& entry : PATTERNS) {
+        BENCHMARK("find_pattern_address_parallel: " + entry.first) {
+            return koalabox::patcher::find_pattern_address_parallel(base, BUFFER_SIZE, entry.first, entry.second);
+        };
+    }
+
+    const auto precompiled = koalabox::patcher::pattern::from_str(PATTERNS.at("wildcards"));
+    BENCHMARK("find_pattern_address: precompiled wildcards") {
+        return koalabox::patcher::find_pattern_address(base, BUFFER_SIZE, "precompiled", precompiled);
+    };
+
+    BENCHMARK("find_all_pattern_addresses: 48 8B 05") {
+        return koalabox::patcher::find_all_pattern_addresses(base, BUFFER_SIZE, "all", "48 8B 05");
+    };
+
+    BENCHMARK("find_pattern_addresses: all patterns in one pass") {
+        return koalabox::patcher::find_pattern_addresses(base, BUFFER_SIZE, PATTERNS);
+    };
+}
+
+TEST_CASE("Function start lookup", "[!benchmark][re]") {
+    const auto entry = reinterpret_cast<uintptr_t>(&detour_target);
+
+    // The first lookup populates the module cache, subsequent ones measure the steady state
+    REQUIRE(koalabox::re::get_function_start(entry + 4) == entry);
+
+    BENCHMARK("get_function_start") {
+        return koalabox::re::get_function_start(entry + 4);
+    };
+}
+
+TEST_CASE("Detour cycle", "[!benchmark][hook]") {
+    koalabox::logger::init_null_logger();
+    koalabox::hook::init();
+
+    auto* const target = reinterpret_cast<void*>(&detour_target);
+    auto* const callback = reinterpret_cast<void*>(&detour_callback);
+
+    BENCHMARK("detour + unhook") {
+        koalabox::hook::detour(target, "detour_target", callback);
+        return koalabox::hook::unhook("detour_target");
+    };
+
+    koalabox::hook::detour(target, "detour_target", callback);
+    BENCHMARK("get_hooked_function_address: by name") {
+        return koalabox::hook::get_hooked_function_address("detour_target");
+    };
+
+    const auto hook_id = koalabox::hook::get_hook_id("detour_target");
+    BENCHMARK("get_hooked_function_address: by id") {
+        return koalabox::hook::get_hooked_function_address(hook_id);
+    };
+    koalabox::hook::unhook("detour_target");
+}
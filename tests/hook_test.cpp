@@ -0,0 +1,314 @@
+#include <algorithm>
+
+#if !defined(_WIN32)
+#include <dlfcn.h>
+#include <unistd.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "koalabox/hook.hpp"
+#include "koalabox/logger.hpp"
+
+#if defined(_MSC_VER)
+#define KB_TEST_NOINLINE __declspec(noinline)
+#else
+#define KB_TEST_NOINLINE [[gnu::noinline]]
+#endif
+
+namespace {
+    KB_TEST_NOINLINE int sink(const int value) {
+        volatile int v = value;
+        return v;
+    }
+
+    // Long enough to leave room for the detour jump, and non-leaf so that it is not folded or inlined
+    KB_TEST_NOINLINE int hook_test_target(const int seed) {
+        int acc = seed;
+        for(int i = 0; i < 5; ++i) {
+            acc = sink(acc + i);
+        }
+        return acc;
+    }
+
+    KB_TEST_NOINLINE int hook_test_target_b(const int seed) {
+        int acc = seed;
+        for(int i = 0; i < 7; ++i) {
+            acc = sink(acc * 3 + i);
+        }
+        return acc;
+    }
+
+    KB_TEST_NOINLINE int $hook_test_target_b(const int seed) {
+        const auto hook_test_target_b$ = KB_HOOK_GET_HOOKED_FN(hook_test_target_b);
+
+        return hook_test_target_b$(seed) + 2000;
+    }
+
+    KB_TEST_NOINLINE int $hook_test_target(const int seed) {
+        const auto hook_test_target$ = KB_HOOK_GET_HOOKED_FN(hook_test_target);
+
+        return hook_test_target$(seed) + 1000;
+    }
+
+    KB_TEST_NOINLINE int instrumented_function(const int value) {
+        KB_HOOK_INSTRUMENT(instrumented_function);
+
+        return sink(value);
+    }
+
+#if !defined(_WIN32)
+    pid_t $getpid() {
+        const auto getpid$ = KB_HOOK_GET_HOOKED_FN(getpid);
+
+        return getpid$() + 1000000;
+    }
+
+    KB_TEST_NOINLINE pid_t call_getpid() {
+        return getpid();
+    }
+#endif
+
+    void init_hooks() {
+        koalabox::logger::init_null_logger();
+        koalabox::hook::init();
+    }
+}
+
+TEST_CASE("Hook ids are stable and distinct", "[hook]") {
+    const auto first = koalabox::hook::get_hook_id("hook_id_test_first");
+    const auto second = koalabox::hook::get_hook_id("hook_id_test_second");
+
+    CHECK(first != second);
+    CHECK(koalabox::hook::get_hook_id("hook_id_test_first") == first);
+    CHECK(koalabox::hook::get_hook_id("hook_id_test_second") == second);
+}
+
+TEST_CASE("Hooked function resolves its trampoline by id", "[hook]") {
+    init_hooks();
+
+    const auto expected = hook_test_target(1);
+
+    koalabox::hook::detour(
+        reinterpret_cast<void*>(&hook_test_target),
+        "hook_test_target",
+        reinterpret_cast<void*>(&$hook_test_target)
+    );
+    REQUIRE(koalabox::hook::is_hooked("hook_test_target"));
+
+    CHECK(hook_test_target(1) == expected + 1000);
+    CHECK(
+        koalabox::hook::get_hooked_function_address("hook_test_target") ==
+        koalabox::hook::get_hooked_function_address(koalabox::hook::get_hook_id("hook_test_target"))
+    );
+
+    REQUIRE(koalabox::hook::unhook("hook_test_target"));
+    CHECK_FALSE(koalabox::hook::is_hooked("hook_test_target"));
+    CHECK(hook_test_target(1) == expected);
+
+    // The id outlives the hook, so hooking again must be visible through the same id
+    koalabox::hook::detour(
+        reinterpret_cast<void*>(&hook_test_target),
+        "hook_test_target",
+        reinterpret_cast<void*>(&$hook_test_target)
+    );
+    CHECK(hook_test_target(1) == expected + 1000);
+    REQUIRE(koalabox::hook::unhook("hook_test_target"));
+}
+
+TEST_CASE("Hooking an already hooked function replaces its hook", "[hook]") {
+    init_hooks();
+
+    const auto expected = hook_test_target(1);
+
+    for(int i = 0; i < 2; ++i) {
+        koalabox::hook::detour(
+            reinterpret_cast<void*>(&hook_test_target),
+            "hook_test_target",
+            reinterpret_cast<void*>(&$hook_test_target)
+        );
+    }
+
+    // Hooks must not stack, and the replaced one must not be left behind
+    CHECK(hook_test_target(1) == expected + 1000);
+
+    REQUIRE(koalabox::hook::unhook("hook_test_target"));
+    CHECK(hook_test_target(1) == expected);
+
+    void* vtable[] = {reinterpret_cast<void*>(&hook_test_target), reinterpret_cast<void*>(&hook_test_target_b)};
+    koalabox::hook::virtual_class_t instance{vtable};
+
+    for(int i = 0; i < 2; ++i) {
+        koalabox::hook::swap_virtual_func(&instance, "hook_test_target_b", 1, reinterpret_cast<void*>(&$hook_test_target_b));
+    }
+
+    // The original must not be mistaken for the callback of the replaced hook
+    const auto original = KB_HOOK_GET_SWAPPED_FN(&instance, hook_test_target_b);
+    CHECK(reinterpret_cast<void*>(original) == reinterpret_cast<void*>(&hook_test_target_b));
+
+    REQUIRE(koalabox::hook::unhook_vt(&instance, "hook_test_target_b"));
+    CHECK(vtable[1] == reinterpret_cast<void*>(&hook_test_target_b));
+}
+
+TEST_CASE("Batch detour installs all hooks or none", "[hook]") {
+    init_hooks();
+
+    const auto expected_a = hook_test_target(1);
+    const auto expected_b = hook_test_target_b(1);
+
+    SECTION("Invalid batch patches nothing") {
+        REQUIRE_THROWS(
+            koalabox::hook::detour_batch_or_throw(
+                {
+                    {reinterpret_cast<void*>(&hook_test_target), "hook_test_target", reinterpret_cast<void*>(&$hook_test_target)},
+                    {reinterpret_cast<void*>(&hook_test_target_b), "hook_test_target", reinterpret_cast<void*>(&$hook_test_target_b)},
+                }
+            )
+        );
+
+        CHECK_FALSE(koalabox::hook::is_hooked("hook_test_target"));
+        CHECK(hook_test_target(1) == expected_a);
+        CHECK(hook_test_target_b(1) == expected_b);
+    }
+
+    SECTION("Valid batch hooks every entry") {
+        koalabox::hook::detour_batch(
+            {
+                {reinterpret_cast<void*>(&hook_test_target), "hook_test_target", reinterpret_cast<void*>(&$hook_test_target)},
+                {reinterpret_cast<void*>(&hook_test_target_b), "hook_test_target_b", reinterpret_cast<void*>(&$hook_test_target_b)},
+            }
+        );
+
+        CHECK(hook_test_target(1) == expected_a + 1000);
+        CHECK(hook_test_target_b(1) == expected_b + 2000);
+
+        REQUIRE(koalabox::hook::unhook("hook_test_target"));
+        REQUIRE(koalabox::hook::unhook("hook_test_target_b"));
+    }
+}
+
+TEST_CASE("Swapped virtual function resolves its original by class and id", "[hook]") {
+    init_hooks();
+
+    // Fake objects whose first member is a vtable pointer, just like in polymorphic classes
+    void* vtable[] = {reinterpret_cast<void*>(&hook_test_target), reinterpret_cast<void*>(&hook_test_target_b)};
+    koalabox::hook::virtual_class_t first{vtable};
+    koalabox::hook::virtual_class_t second{vtable};
+
+    koalabox::hook::swap_virtual_func(&first, "hook_test_target_b", 1, reinterpret_cast<void*>(&$hook_test_target_b));
+
+    CHECK(vtable[1] == reinterpret_cast<void*>(&$hook_test_target_b));
+    CHECK(koalabox::hook::is_vt_hooked(&first, "hook_test_target_b"));
+    CHECK_FALSE(koalabox::hook::is_vt_hooked(&second, "hook_test_target_b"));
+
+    const auto original = KB_HOOK_GET_SWAPPED_FN(&first, hook_test_target_b);
+    CHECK(reinterpret_cast<void*>(original) == reinterpret_cast<void*>(&hook_test_target_b));
+
+    // Unknown class pointers fall back to the last class that hooked the function
+    CHECK(
+        koalabox::hook::get_swapped_function_address(&second, "hook_test_target_b") ==
+        reinterpret_cast<void*>(&hook_test_target_b)
+    );
+
+    REQUIRE(koalabox::hook::unhook_vt(&first, "hook_test_target_b"));
+    CHECK(vtable[1] == reinterpret_cast<void*>(&hook_test_target_b));
+}
+
+TEST_CASE("Hooks of unloaded memory are forgotten without unhooking", "[hook]") {
+    init_hooks();
+
+    void* vtable[] = {reinterpret_cast<void*>(&hook_test_target), reinterpret_cast<void*>(&hook_test_target_b)};
+    koalabox::hook::virtual_class_t classes[2] = {{vtable}, {vtable}};
+
+    koalabox::hook::swap_virtual_func(&classes[0], "hook_test_target_b", 1, reinterpret_cast<void*>(&$hook_test_target_b));
+    REQUIRE(koalabox::hook::is_vt_hooked(&classes[0], "hook_test_target_b"));
+
+    // Range that does not contain the instance leaves the hook alone
+    CHECK(koalabox::hook::forget_hooks_in_range(&classes[1], &classes[2]) == 0);
+    CHECK(koalabox::hook::is_vt_hooked(&classes[0], "hook_test_target_b"));
+
+    CHECK(koalabox::hook::forget_hooks_in_range(&classes[0], &classes[1]) == 1);
+    CHECK_FALSE(koalabox::hook::is_vt_hooked(&classes[0], "hook_test_target_b"));
+
+    // Memory of an unloaded module must not be touched, hence the patch stays in place
+    CHECK(vtable[1] == reinterpret_cast<void*>(&$hook_test_target_b));
+}
+
+TEST_CASE("Shared vtable hook serves every instance", "[hook]") {
+    init_hooks();
+
+    void* vtable[] = {reinterpret_cast<void*>(&hook_test_target), reinterpret_cast<void*>(&hook_test_target_b)};
+    koalabox::hook::virtual_class_t first{vtable};
+    koalabox::hook::virtual_class_t second{vtable};
+
+    koalabox::hook::swap_shared_virtual_func(&first, "hook_test_target_b", 1, reinterpret_cast<void*>(&$hook_test_target_b));
+    // Same vtable, hence nothing to do
+    koalabox::hook::swap_shared_virtual_func(&second, "hook_test_target_b", 1, reinterpret_cast<void*>(&$hook_test_target_b));
+
+    CHECK(vtable[1] == reinterpret_cast<void*>(&$hook_test_target_b));
+    CHECK(koalabox::hook::is_vt_hooked(&first, "hook_test_target_b"));
+    CHECK(koalabox::hook::is_vt_hooked(&second, "hook_test_target_b"));
+
+    const auto original = KB_HOOK_GET_SWAPPED_FN(&second, hook_test_target_b);
+    CHECK(reinterpret_cast<void*>(original) == reinterpret_cast<void*>(&hook_test_target_b));
+
+    REQUIRE(koalabox::hook::unhook_vt(&second, "hook_test_target_b"));
+    CHECK(vtable[1] == reinterpret_cast<void*>(&hook_test_target_b));
+    CHECK_FALSE(koalabox::hook::is_vt_hooked(&first, "hook_test_target_b"));
+}
+
+TEST_CASE("Instrumentation counts hook invocations", "[hook]") {
+    init_hooks();
+
+    instrumented_function(0); // Not counted while instrumentation is disabled
+
+    koalabox::hook::enable_instrumentation(4);
+    for(int i = 0; i < 100; ++i) {
+        instrumented_function(i);
+    }
+    koalabox::hook::disable_instrumentation();
+
+    const auto snapshot = koalabox::hook::get_instrumentation_snapshot();
+    const auto stats = std::ranges::find(snapshot, "instrumented_function", &koalabox::hook::hook_stats_t::function_name);
+
+    REQUIRE(stats != snapshot.end());
+    CHECK(stats->call_count == 100);
+    CHECK(stats->sampled_call_count == 25);
+
+    koalabox::hook::reset_instrumentation();
+    CHECK(std::ranges::none_of(
+        koalabox::hook::get_instrumentation_snapshot(),
+        [](const auto& entry) { return entry.function_name == "instrumented_function"; }
+    ));
+}
+
+#if !defined(_WIN32)
+TEST_CASE("Import hook redirects calls through the GOT", "[hook]") {
+    init_hooks();
+
+    auto* const self_module = dlopen(nullptr, RTLD_NOW);
+    const auto pid = call_getpid();
+
+    koalabox::hook::hook_import(self_module, "getpid", reinterpret_cast<void*>(&$getpid));
+    REQUIRE(koalabox::hook::is_import_hooked(self_module, "getpid"));
+
+    CHECK(call_getpid() == pid + 1000000);
+
+    // Detour would take over the trampoline slot through which the import hook resolves the original
+    CHECK_THROWS(
+        koalabox::hook::detour_or_throw(
+            reinterpret_cast<void*>(&getpid),
+            "getpid",
+            reinterpret_cast<void*>(&$getpid)
+        )
+    );
+
+    REQUIRE(koalabox::hook::unhook_import(self_module, "getpid"));
+    CHECK(call_getpid() == pid);
+
+    const auto hook_id = koalabox::hook::get_hook_id("getpid");
+    CHECK(koalabox::hook::details::trampolines[hook_id].load() == nullptr);
+
+    CHECK_THROWS(koalabox::hook::hook_import_or_throw(self_module, "no_such_import", reinterpret_cast<void*>(&$getpid)));
+}
+#endif
@@ -0,0 +1,59 @@
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "koalabox/lib_monitor.hpp"
+
+namespace {
+    namespace lib_monitor = koalabox::lib_monitor;
+
+    lib_monitor::callbacks_t make_callbacks(const std::vector<std::string>& names) {
+        lib_monitor::callbacks_t callbacks;
+        for(const auto& name : names) {
+            callbacks[name] = [](void*) { return true; };
+        }
+        return callbacks;
+    }
+}
+
+TEST_CASE("Library names are matched according to their rules", "[lib_monitor]") {
+    const lib_monitor::details::lib_name_matcher matcher(
+        make_callbacks({"steam_api", "libfoo", "lib*bar?", "*_x64"}),
+        {
+            {"libfoo", lib_monitor::match_t::prefix},
+            {"lib*bar?", lib_monitor::match_t::glob},
+            {"*_x64", lib_monitor::match_t::glob},
+        }
+    );
+
+    using names_t = std::vector<std::string>;
+
+    CHECK(matcher.match("steam_api") == names_t{"steam_api"});
+    CHECK(matcher.match("Steam_API") == names_t{"steam_api"});
+    CHECK(matcher.match("steam_api64").empty());
+
+    CHECK(matcher.match("libfoo") == names_t{"libfoo"});
+    CHECK(matcher.match("LibFooBarX") == names_t({"lib*bar?", "libfoo"}));
+    CHECK(matcher.match("libfo").empty());
+
+    CHECK(matcher.match("libbar1") == names_t{"lib*bar?"});
+    CHECK(matcher.match("lib_something_bar2") == names_t{"lib*bar?"});
+    CHECK(matcher.match("libbar").empty());
+
+    CHECK(matcher.match("engine_x64") == names_t{"*_x64"});
+    CHECK(matcher.match("engine_x86").empty());
+}
+
+TEST_CASE("Library names exclude extension and version", "[lib_monitor]") {
+    using lib_monitor::details::get_lib_name;
+
+#if defined(_WIN32)
+    CHECK(get_lib_name(R"(C:\Games\steam_api64.dll)") == "steam_api64");
+#else
+    CHECK(get_lib_name("/usr/lib/libfoo.so") == "libfoo");
+    CHECK(get_lib_name("/usr/lib/libfoo.so.1.2") == "libfoo");
+    CHECK(get_lib_name("libsound.so_backup.so") == "libsound.so_backup");
+    CHECK(get_lib_name("plugin.bin") == "plugin");
+#endif
+}
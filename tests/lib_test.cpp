@@ -0,0 +1,66 @@
+#include <set>
+#include <string>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "koalabox/lib.hpp"
+
+namespace {
+    // A system library that is always loaded and exports plenty of functions, some of them versioned or forwarded
+    void* get_system_module() {
+#if defined(_WIN32)
+        return GetModuleHandleW(L"kernel32.dll");
+#else
+        return dlopen("libc.so.6", RTLD_NOW | RTLD_NOLOAD);
+#endif
+    }
+}
+
+TEST_CASE("get_function_addresses agrees with get_function_address", "[lib]") {
+    auto* const module = get_system_module();
+    REQUIRE(module);
+
+#if defined(_WIN32)
+    const std::set<std::string> function_names = {
+        "CreateFileW", "GetProcAddress", "HeapAlloc", "Sleep", "no_such_function"
+    };
+#else
+    const std::set<std::string> function_names = {
+        "dlopen", "getpid", "malloc", "memcpy", "printf", "no_such_function"
+    };
+#endif
+
+    const auto addresses = koalabox::lib::get_function_addresses(module, function_names);
+
+    for(const auto& function_name : function_names) {
+        INFO(function_name);
+
+        const auto expected = koalabox::lib::get_function_address(module, function_name.c_str());
+        const auto it = addresses.find(function_name);
+
+        if(expected) {
+            REQUIRE(it != addresses.end());
+            CHECK(it->second == *expected);
+        } else {
+            CHECK(it == addresses.end());
+        }
+    }
+}
+
+TEST_CASE("Symbol index is built once per module", "[lib]") {
+    auto* const module = get_system_module();
+    REQUIRE(module);
+
+    const auto index = koalabox::lib::get_symbol_index(module);
+    REQUIRE(index);
+    CHECK_FALSE(index->addresses.empty());
+    CHECK(koalabox::lib::get_symbol_index(module) == index);
+
+    CHECK_FALSE(index->find("no_such_function"));
+}
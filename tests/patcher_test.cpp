@@ -0,0 +1,387 @@
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <dlfcn.h> // dlopen(nullptr) yields the handle of the main executable
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "koalabox/cache.hpp"
+#include "koalabox/globals.hpp"
+#include "koalabox/lib.hpp"
+#include "koalabox/patcher.hpp"
+#include "koalabox/path.hpp"
+#include "koalabox/paths.hpp"
+
+namespace {
+    uintptr_t find(const std::vector<uint8_t>& buffer, const std::string& pattern) {
+        return koalabox::patcher::find_pattern_address(
+            reinterpret_cast<uintptr_t>(buffer.data()),
+            buffer.size(),
+            "test",
+            pattern
+        );
+    }
+
+    uintptr_t address_at(const std::vector<uint8_t>& buffer, const size_t offset) {
+        return reinterpret_cast<uintptr_t>(buffer.data() + offset);
+    }
+
+    // A buffer large enough to exercise the vectorized loop, filled with bytes that never occur in
+    // the patterns below, so the only matches are the ones a test plants explicitly.
+    std::vector<uint8_t> make_buffer(const size_t size = 4096) {
+        return std::vector<uint8_t>(size, 0x90);
+    }
+
+    void* get_self_module() {
+#if defined(_WIN32)
+        return koalabox::lib::get_exe_handle();
+#else
+        return dlopen(nullptr, RTLD_NOW);
+#endif
+    }
+
+    // Cached lookups need a module with a file on disk, which dlopen(nullptr) does not provide on Linux
+    void* get_cached_module() {
+#if defined(_WIN32)
+        return koalabox::lib::get_exe_handle();
+#else
+        return dlopen("libc.so.6", RTLD_NOW | RTLD_NOLOAD);
+#endif
+    }
+}
+
+TEST_CASE("find_pattern_address finds an exact pattern", "[patcher]") {
+    auto buffer = make_buffer();
+    const std::vector<uint8_t> bytes = {0x48, 0x8B, 0x05, 0x12, 0x34};
+    std::ranges::copy(bytes, buffer.begin() + 1000);
+
+    REQUIRE(find(buffer, "48 8B 05 12 34") == address_at(buffer, 1000));
+}
+
+TEST_CASE("find_pattern_address honours wildcards", "[patcher]") {
+    auto buffer = make_buffer();
+    const std::vector<uint8_t> bytes = {0xE8, 0xAA, 0xBB, 0xCC, 0xDD, 0x84, 0xC0};
+    std::ranges::copy(bytes, buffer.begin() + 333);
+
+    REQUIRE(find(buffer, "E8 ?? ?? ?? ?? 84 C0") == address_at(buffer, 333));
+}
+
+TEST_CASE("find_pattern_address returns the first of several matches", "[patcher]") {
+    auto buffer = make_buffer();
+    buffer[100] = 0x11;
+    buffer[101] = 0x22;
+    buffer[3000] = 0x11;
+    buffer[3001] = 0x22;
+
+    REQUIRE(find(buffer, "11 22") == address_at(buffer, 100));
+}
+
+TEST_CASE("find_pattern_address finds a match ending at the last byte of the region", "[patcher]") {
+    auto buffer = make_buffer();
+    buffer[buffer.size() - 2] = 0xDE;
+    buffer[buffer.size() - 1] = 0xAD;
+
+    REQUIRE(find(buffer, "DE AD") == address_at(buffer, buffer.size() - 2));
+}
+
+TEST_CASE("find_pattern_address returns 0 when there is no match", "[patcher]") {
+    const auto buffer = make_buffer();
+
+    REQUIRE(find(buffer, "DE AD BE EF") == 0);
+}
+
+TEST_CASE("find_pattern_address returns 0 when the pattern is longer than the region", "[patcher]") {
+    const auto buffer = make_buffer(3);
+
+    REQUIRE(find(buffer, "90 90 90 90") == 0);
+}
+
+TEST_CASE("find_pattern_address agrees with a naive scan on random data", "[patcher]") {
+    // A small alphabet produces plenty of partial matches, which is where the anchor filtering
+    // and the vectorized verification could diverge from a plain byte-by-byte comparison.
+    std::mt19937 rng(42); // NOLINT(*-msc51-cpp)
+
+    for(int iteration = 0; iteration < 500; ++iteration) {
+        std::vector<uint8_t> buffer(rng() % 2048);
+        for(auto& byte : buffer) {
+            byte = static_cast<uint8_t>(rng() % 4);
+        }
+
+        std::string pattern;
+        std::vector<int> expected; // -1 denotes a wildcard
+        const auto pattern_size = 1 + rng() % 48;
+        for(size_t i = 0; i < pattern_size; ++i) {
+            if(rng() % 4 == 0) {
+                pattern += "?? ";
+                expected.push_back(-1);
+            } else {
+                const auto byte = static_cast<int>(rng() % 4);
+                pattern += std::format("{:02X} ", byte);
+                expected.push_back(byte);
+            }
+        }
+
+        uintptr_t reference = 0;
+        for(size_t offset = 0; offset + expected.size() <= buffer.size() && !reference; ++offset) {
+            bool matches = true;
+            for(size_t i = 0; i < expected.size() && matches; ++i) {
+                matches = expected[i] == -1 || expected[i] == buffer[offset + i];
+            }
+            if(matches) {
+                reference = address_at(buffer, offset);
+            }
+        }
+
+        INFO("Pattern: " << pattern << ", buffer size: " << buffer.size());
+        REQUIRE(find(buffer, pattern) == reference);
+
+        // The engine picked at runtime hides the others, hence each one is compared on its own
+        using koalabox::patcher::details::scan_engine;
+        for(const auto engine : {scan_engine::scalar, scan_engine::sse2, scan_engine::avx2}) {
+            if(!koalabox::patcher::details::is_engine_supported(engine)) {
+                continue;
+            }
+
+            INFO("Engine: " << static_cast<int>(engine));
+            REQUIRE(
+                koalabox::patcher::details::find_with_engine(
+                    engine,
+                    reinterpret_cast<uintptr_t>(buffer.data()),
+                    buffer.size(),
+                    koalabox::patcher::pattern::from_str(pattern)
+                ) == reference
+            );
+        }
+    }
+}
+
+TEST_CASE("find_pattern_addresses resolves several patterns in one pass", "[patcher]") {
+    auto buffer = make_buffer();
+    const std::vector<uint8_t> first = {0x40, 0x53, 0x48, 0x83, 0xEC, 0x20};
+    const std::vector<uint8_t> second = {0xE8, 0x01, 0x02, 0x03, 0x04, 0x84, 0xC0};
+    std::ranges::copy(first, buffer.begin() + 2500);
+    std::ranges::copy(second, buffer.begin() + 700);
+    std::ranges::copy(second, buffer.begin() + 1700);
+
+    const auto addresses = koalabox::patcher::find_pattern_addresses(
+        reinterpret_cast<uintptr_t>(buffer.data()),
+        buffer.size(),
+        {
+            {"first", "40 53 48 83 EC ??"},
+            {"second", "E8 ?? ?? ?? ?? 84 C0"},
+            {"missing", "DE AD BE EF"},
+        }
+    );
+
+    REQUIRE(addresses.size() == 2);
+    REQUIRE(addresses.at("first") == address_at(buffer, 2500));
+    REQUIRE(addresses.at("second") == address_at(buffer, 700));
+    REQUIRE_FALSE(addresses.contains("missing"));
+}
+
+TEST_CASE("find_pattern_address_parallel finds a match straddling a chunk boundary", "[patcher]") {
+    // Several MiB so that the region is split into multiple chunks
+    auto buffer = make_buffer(5 * 1024 * 1024 + 17);
+    const std::vector<uint8_t> bytes = {0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC};
+    const auto boundary_offset = 3 * 1024 * 1024 - 3;
+    std::ranges::copy(bytes, buffer.begin() + boundary_offset);
+    std::ranges::copy(bytes, buffer.begin() + 4 * 1024 * 1024 + 5);
+
+    const auto address = koalabox::patcher::find_pattern_address_parallel(
+        reinterpret_cast<uintptr_t>(buffer.data()),
+        buffer.size(),
+        "test",
+        "12 34 56 ?? 9A BC",
+        4
+    );
+
+    REQUIRE(address == address_at(buffer, boundary_offset));
+    REQUIRE(address == find(buffer, "12 34 56 ?? 9A BC"));
+}
+
+TEST_CASE("static_pattern is parsed at compile time", "[patcher]") {
+    constexpr koalabox::patcher::static_pattern signature = "48 8b ?? 05";
+
+    STATIC_REQUIRE(signature.size == 4);
+    STATIC_REQUIRE(signature.bytes[0] == 0x48);
+    STATIC_REQUIRE(signature.bytes[1] == 0x8B);
+    STATIC_REQUIRE(signature.mask[1] == 0xFF);
+    STATIC_REQUIRE(signature.mask[2] == 0x00);
+    STATIC_REQUIRE(signature.bytes[3] == 0x05);
+}
+
+TEST_CASE("find_pattern_address accepts a precompiled pattern", "[patcher]") {
+    auto buffer = make_buffer();
+    const std::vector<uint8_t> bytes = {0xE8, 0xAA, 0xBB, 0xCC, 0xDD, 0x84, 0xC0};
+    std::ranges::copy(bytes, buffer.begin() + 1234);
+
+    static const koalabox::patcher::pattern signature =
+        koalabox::patcher::static_pattern("E8 ?? ?? ?? ?? 84 C0");
+
+    REQUIRE(
+        koalabox::patcher::find_pattern_address(
+            reinterpret_cast<uintptr_t>(buffer.data()),
+            buffer.size(),
+            "test",
+            signature
+        ) == address_at(buffer, 1234)
+    );
+}
+
+TEST_CASE("pattern::from_str rejects malformed patterns", "[patcher]") {
+    using koalabox::patcher::pattern;
+
+    REQUIRE_THROWS_AS(pattern::from_str(""), std::invalid_argument);
+    REQUIRE_THROWS_AS(pattern::from_str("48 8"), std::invalid_argument);
+    REQUIRE_THROWS_AS(pattern::from_str("48 XY"), std::invalid_argument);
+    REQUIRE(pattern::from_str("488B ??").size() == 3);
+}
+
+TEST_CASE("find_pattern_address returns 0 for a malformed pattern", "[patcher]") {
+    const auto buffer = make_buffer();
+
+    REQUIRE(find(buffer, "90 9") == 0);
+}
+
+TEST_CASE("find_all_pattern_addresses returns every match in order", "[patcher]") {
+    auto buffer = make_buffer();
+    // Overlapping occurrences must be reported too
+    for(const auto offset : {10, 11, 12, 2000, 4094}) {
+        buffer[offset] = 0xAB;
+        buffer[offset + 1] = 0xAB;
+    }
+
+    const auto base = reinterpret_cast<uintptr_t>(buffer.data());
+
+    const auto all = koalabox::patcher::find_all_pattern_addresses(base, buffer.size(), "test", "AB AB");
+    REQUIRE(
+        all == std::vector{
+            address_at(buffer, 10),
+            address_at(buffer, 11),
+            address_at(buffer, 12),
+            address_at(buffer, 2000),
+            address_at(buffer, 4094),
+        }
+    );
+
+    const auto limited = koalabox::patcher::find_all_pattern_addresses(base, buffer.size(), "test", "AB AB", 2);
+    REQUIRE(limited == std::vector{address_at(buffer, 10), address_at(buffer, 11)});
+}
+
+TEST_CASE("find_unique_pattern_address rejects ambiguous patterns", "[patcher]") {
+    auto buffer = make_buffer();
+    buffer[100] = 0x11;
+    buffer[101] = 0x22;
+    buffer[3000] = 0x11;
+    buffer[3001] = 0x22;
+    buffer[3002] = 0x33;
+
+    const auto base = reinterpret_cast<uintptr_t>(buffer.data());
+
+    REQUIRE(koalabox::patcher::find_unique_pattern_address(base, buffer.size(), "test", "11 22") == 0);
+    REQUIRE(
+        koalabox::patcher::find_unique_pattern_address(base, buffer.size(), "test", "11 22 33") ==
+        address_at(buffer, 3000)
+    );
+}
+
+TEST_CASE("find_in_module finds code of the test binary itself", "[patcher]") {
+    // The entry of any function in this binary lies in one of its executable regions
+    const auto entry = reinterpret_cast<uintptr_t>(&make_buffer);
+    const auto* const code = reinterpret_cast<const uint8_t*>(entry);
+
+    const koalabox::patcher::pattern signature(
+        std::vector(code, code + 16),
+        std::vector<uint8_t>(16, 0xFF)
+    );
+
+    const auto address = koalabox::patcher::find_in_module(get_self_module(), "make_buffer", signature);
+
+    // Identical code may precede the function, in which case the lowest address wins
+    REQUIRE(address != 0);
+    REQUIRE(address <= entry);
+    REQUIRE(std::equal(code, code + 16, reinterpret_cast<const uint8_t*>(address)));
+}
+
+TEST_CASE("find_pattern_address_cached reuses valid cached addresses only", "[patcher]") {
+    // Paths are resolved once per process, hence a project name unique to this run yields a temporary cache file
+    // next to the test binary. Globals are restored afterwards, in case other tests rely on them.
+    std::optional<std::pair<void*, std::string>> previous_globals;
+    try {
+        previous_globals.emplace(koalabox::globals::get_self_handle(), koalabox::globals::get_project_name());
+    } catch(const std::runtime_error&) {
+        // Not initialized yet
+    }
+
+#if defined(_WIN32)
+    void* const self_handle = koalabox::lib::get_exe_handle();
+#else
+    void* const self_handle = nullptr; // Null handle stands for the executable on Linux
+#endif
+    const auto project_name = std::format("KoalaBoxTests-{}", std::random_device()());
+    koalabox::globals::init_globals(self_handle, project_name);
+
+    const auto cache_path = koalabox::paths::get_cache_path();
+    const struct cleanup_t {
+        std::filesystem::path cache_path;
+        std::optional<std::pair<void*, std::string>> previous_globals;
+
+        ~cleanup_t() {
+            std::error_code ec;
+            std::filesystem::remove(cache_path, ec);
+
+            if(previous_globals) {
+                koalabox::globals::init_globals(previous_globals->first, previous_globals->second);
+            }
+        }
+    } cleanup{cache_path, previous_globals};
+
+    // Otherwise, the paths were resolved before and the test would overwrite a cache file that is not its own
+    REQUIRE(koalabox::path::to_str(cache_path.filename()) == project_name + ".cache.json");
+
+    auto* const module = get_cached_module();
+    REQUIRE(module);
+
+    const auto module_address = reinterpret_cast<uintptr_t>(koalabox::lib::get_base_address(module).value());
+    const auto cache_key = std::format("patcher:{}", koalabox::path::to_str(koalabox::lib::get_fs_path(module)));
+
+    auto buffer = make_buffer();
+    const auto base = reinterpret_cast<uintptr_t>(buffer.data());
+    const auto find_cached = [&] {
+        return koalabox::patcher::find_pattern_address_cached(module, base, buffer.size(), "test", "11 22 33 44");
+    };
+    const auto plant = [&](const size_t offset) {
+        std::copy_n(std::vector<uint8_t>{0x11, 0x22, 0x33, 0x44}.begin(), 4, buffer.begin() + offset);
+    };
+
+    plant(1000);
+    plant(3000);
+
+    // Entry of another build of the module must be ignored, even though the pattern matches at its address
+    koalabox::cache::put(
+        cache_key,
+        {{"identity", "0:0"}, {"patterns", {{"11 22 33 44", address_at(buffer, 3000) - module_address}}}}
+    );
+    CHECK(find_cached() == address_at(buffer, 1000)); // Miss
+
+    // Earlier match would win a scan, hence finding the previous address proves that the cache was used
+    plant(500);
+    CHECK(find_cached() == address_at(buffer, 1000)); // Hit
+
+    // Pattern no longer matches at the cached address
+    buffer[1000] = 0x90;
+    CHECK(find_cached() == address_at(buffer, 500));
+
+    const auto entry = koalabox::cache::get(cache_key);
+    CHECK(entry["patterns"]["11 22 33 44"].get<uintptr_t>() == address_at(buffer, 500) - module_address);
+}
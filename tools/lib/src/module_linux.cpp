@@ -1,5 +1,6 @@
-#include <elfio/elfio.hpp>
+#include <elf.h>
 
+#include <koalabox/elf.hpp>
 #include <koalabox/logger.hpp>
 #include <koalabox/path.hpp>
 
@@ -9,40 +10,29 @@ namespace koalabox::tools::module {
     std::optional<exports_t> get_exports(const std::filesystem::path& module_path) {
         const auto module_path_str = path::to_str(module_path);
 
-        ELFIO::elfio reader;
-        if(!reader.load(module_path_str)) {
+        const auto elf_file = elf::file::open(module_path);
+        if(!elf_file) {
             LOG_ERROR("Failed to read ELF file: {}", module_path_str);
             return std::nullopt;
         }
 
-        ELFIO::section* dynsym = reader.sections[".dynsym"];
-        if(!dynsym) {
+        const auto symbols = elf_file->get_dynamic_symbols();
+        if(symbols.empty()) {
             LOG_ERROR("Failed to find dynamic symbol table section: {}", module_path_str);
             return std::nullopt;
         }
 
         exports_t results;
 
-        const ELFIO::symbol_section_accessor symbols(reader, dynsym);
-        for(auto i = 0U; i < symbols.get_symbols_num(); ++i) {
-            std::string name;
-            ELFIO::Elf64_Addr value;
-            ELFIO::Elf_Xword size;
-            unsigned char bind;
-            unsigned char type;
-            unsigned char other;
-            ELFIO::Elf_Half section_index;
-
-            symbols.get_symbol(i, name, value, size, bind, type, section_index, other);
-
+        for(const auto& symbol : symbols) {
             if(
-                section_index != ELFIO::SHN_UNDEF && // Exported, not just referenced
-                bind == ELFIO::STB_GLOBAL && // GLOBAL binding
-                (type == ELFIO::STT_FUNC || type == ELFIO::STT_OBJECT) && // FUNC or OBJECT type
-                (other & 0x3) == ELFIO::STV_DEFAULT && // Default visibility
-                !name.empty()
+                symbol.section_index != SHN_UNDEF && // Exported, not just referenced
+                symbol.bind == STB_GLOBAL && // GLOBAL binding
+                (symbol.type == STT_FUNC || symbol.type == STT_OBJECT) && // FUNC or OBJECT type
+                symbol.visibility == STV_DEFAULT && // Default visibility
+                !symbol.name.empty()
             ) {
-                results.insert(name);
+                results.emplace(symbol.name);
             }
         }
 